@@ -483,6 +483,10 @@ ICloudProvider::Pointer CloudContext::provider(
       return http_->create(url, method, follow_redirect);
     }
 
+    std::unordered_map<std::string, uint32_t> streamCount() const override {
+      return http_->streamCount();
+    }
+
    private:
     std::shared_ptr<IHttp> http_;
   };
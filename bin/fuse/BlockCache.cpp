@@ -0,0 +1,262 @@
+#include "BlockCache.h"
+
+#include <json/json.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+
+namespace {
+
+std::string block_key(const std::string& file, uint64_t index) {
+  return file + "\n" + std::to_string(index);
+}
+
+// The index sits next to the slab, so it gets the same private treatment.
+std::string read_index(const std::string& filename) {
+#ifdef _WIN32
+  std::stringstream stream;
+  stream << std::ifstream(filename).rdbuf();
+  return stream.str();
+#else
+  std::string data;
+  int fd = ::open(filename.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd == -1) return data;
+  char buffer[4096];
+  ssize_t read_bytes;
+  while ((read_bytes = ::read(fd, buffer, sizeof(buffer))) > 0)
+    data.append(buffer, static_cast<size_t>(read_bytes));
+  close(fd);
+  return data;
+#endif
+}
+
+void write_index(const std::string& filename, const std::string& data) {
+#ifdef _WIN32
+  std::ofstream(filename) << data;
+#else
+  int fd = ::open(filename.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (fd == -1) return;
+  for (size_t written = 0; written < data.size();) {
+    auto result = ::write(fd, data.data() + written, data.size() - written);
+    if (result <= 0) break;
+    written += static_cast<size_t>(result);
+  }
+  close(fd);
+#endif
+}
+
+}  // namespace
+
+BlockCache::BlockCache(const std::string& directory, const std::string& name,
+                       uint64_t capacity)
+    : name_(name.empty() ? "blocks" : name), slot_(capacity / BLOCK_SIZE) {
+  if (!acquire(directory)) {
+    slot_.clear();
+    return;
+  }
+  for (size_t i = slot_.size(); i > 0; i--) free_.push_back(i - 1);
+  load();
+}
+
+BlockCache::~BlockCache() {
+  save();
+#ifndef _WIN32
+  if (lock_ != -1) close(lock_);
+#endif
+}
+
+bool BlockCache::acquire(const std::string& directory) {
+#ifdef _WIN32
+  // The temporary directory is the user's own; the slab is opened without
+  // sharing, which locks it.
+  slab_filename_ = directory + "cloudstorage-" + name_;
+  index_filename_ = slab_filename_ + ".json";
+  for (auto mode : {std::ios::in | std::ios::out | std::ios::binary,
+                    std::ios::in | std::ios::out | std::ios::binary |
+                        std::ios::trunc}) {
+#ifdef _MSC_VER
+    slab_.open(slab_filename_, mode, _SH_DENYRW);
+#else
+    slab_.open(slab_filename_, mode);
+#endif
+    if (slab_.is_open()) return true;
+  }
+  return false;
+#else
+  auto path = directory + "cloudstorage-blocks-" + std::to_string(getuid());
+  if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) return false;
+  struct stat st = {};
+  if (lstat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+      st.st_uid != getuid() || (st.st_mode & 077) != 0)
+    return false;
+  path += "/" + name_;
+  lock_ = ::open((path + ".lock").c_str(),
+                 O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (lock_ == -1) return false;
+  if (flock(lock_, LOCK_EX | LOCK_NB) != 0) {
+    close(lock_);
+    lock_ = -1;
+    return false;
+  }
+  slab_filename_ = path;
+  index_filename_ = path + ".json";
+  int slab = ::open(slab_filename_.c_str(),
+                    O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (slab == -1) return false;
+  close(slab);
+  slab_.open(slab_filename_, std::ios::in | std::ios::out | std::ios::binary);
+  return slab_.is_open();
+#endif
+}
+
+std::string BlockCache::key(const std::string& provider, const std::string& id,
+                            uint64_t size,
+                            std::chrono::system_clock::time_point timestamp) {
+  return provider + "\n" + id + "\n" + std::to_string(size) + "\n" +
+         std::to_string(timestamp.time_since_epoch().count());
+}
+
+template <class Visitor>
+bool BlockCache::visit(const std::string& file, uint64_t offset,
+                       uint64_t size, Visitor visitor) {
+  if (size == 0) return false;
+  for (auto index = offset / BLOCK_SIZE;
+       index <= (offset + size - 1) / BLOCK_SIZE; index++) {
+    auto it = index_.find(block_key(file, index));
+    if (it == index_.end()) return false;
+    auto begin = std::max(offset, index * BLOCK_SIZE) - index * BLOCK_SIZE;
+    auto end =
+        std::min(offset + size, (index + 1) * BLOCK_SIZE) - index * BLOCK_SIZE;
+    if (end > slot_[it->second].size_) return false;
+    if (!visitor(it->second, begin, end - begin)) return false;
+  }
+  return true;
+}
+
+bool BlockCache::contains(const std::string& file, uint64_t offset,
+                          uint64_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return visit(file, offset, size,
+               [](size_t, uint64_t, uint64_t) { return true; });
+}
+
+bool BlockCache::read(const std::string& file, uint64_t offset, uint64_t size,
+                      Buffer& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!visit(file, offset, size,
+             [](size_t, uint64_t, uint64_t) { return true; }))
+    return false;
+  data = Buffer(size);
+  return visit(file, offset, size,
+               [&](size_t slot, uint64_t begin, uint64_t length) {
+                 slab_.seekg(slot * BLOCK_SIZE + begin);
+                 slab_.read(data.extend(length),
+                            static_cast<std::streamsize>(length));
+                 if (!slab_) {
+                   slab_.clear();
+                   erase(slot);
+                   return false;
+                 }
+                 lru_.splice(lru_.begin(), lru_, slot_[slot].lru_);
+                 return true;
+               });
+}
+
+void BlockCache::write(const std::string& file, uint64_t file_size,
+                       uint64_t offset, const Buffer& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (slot_.empty()) return;
+  for (auto index = (offset + BLOCK_SIZE - 1) / BLOCK_SIZE;
+       index * BLOCK_SIZE < file_size; index++) {
+    auto begin = index * BLOCK_SIZE;
+    auto size = std::min(BLOCK_SIZE, file_size - begin);
+    if (begin + size > offset + data.size()) break;
+    auto key = block_key(file, index);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, slot_[it->second].lru_);
+      continue;
+    }
+    if (free_.empty()) erase(lru_.back());
+    auto slot = free_.back();
+    slab_.seekp(slot * BLOCK_SIZE);
+    slab_.write(data.data() + (begin - offset),
+                static_cast<std::streamsize>(size));
+    if (!slab_) {
+      slab_.clear();
+      return;
+    }
+    free_.pop_back();
+    insert(slot, key, size);
+  }
+  slab_.flush();
+}
+
+void BlockCache::insert(size_t slot, const std::string& key, uint64_t size) {
+  slot_[slot].key_ = key;
+  slot_[slot].size_ = size;
+  slot_[slot].lru_ = lru_.insert(lru_.begin(), slot);
+  index_[key] = slot;
+}
+
+void BlockCache::erase(size_t slot) {
+  index_.erase(slot_[slot].key_);
+  lru_.erase(slot_[slot].lru_);
+  slot_[slot].key_.clear();
+  free_.push_back(slot);
+}
+
+void BlockCache::load() {
+  Json::Value json;
+  try {
+    json = util::json::from_string(read_index(index_filename_));
+  } catch (const Json::Exception&) {
+    return;
+  }
+  (void)std::remove(index_filename_.c_str());
+  if (!slab_.is_open() || json["block_size"].asUInt64() != BLOCK_SIZE) return;
+  // Blocks are saved from the most recently used one.
+  for (const auto& block : json["blocks"]) {
+    auto slot = block["slot"].asUInt64();
+    auto key = block["key"].asString();
+    auto size = block["size"].asUInt64();
+    if (slot >= slot_.size() || !slot_[slot].key_.empty() || size == 0 ||
+        size > BLOCK_SIZE || index_.find(key) != index_.end())
+      continue;
+    free_.erase(std::find(free_.begin(), free_.end(), slot));
+    insert(slot, key, size);
+    lru_.splice(lru_.end(), lru_, slot_[slot].lru_);
+  }
+}
+
+void BlockCache::save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!slab_.is_open()) return;
+  slab_.close();
+  Json::Value json;
+  json["block_size"] = Json::UInt64(BLOCK_SIZE);
+  json["blocks"] = Json::Value(Json::arrayValue);
+  for (auto slot : lru_) {
+    Json::Value block;
+    block["slot"] = Json::UInt64(slot);
+    block["key"] = slot_[slot].key_;
+    block["size"] = Json::UInt64(slot_[slot].size_);
+    json["blocks"].append(block);
+  }
+  write_index(index_filename_, util::json::to_string(json));
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,86 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Buffer.h"
+
+namespace cloudstorage {
+
+// Keeps downloaded file contents in a slab file of fixed size blocks, so that
+// they can be read again without the provider, also after a restart. Blocks
+// are addressed by file key and block index, the least recently used ones
+// are evicted once the slab is full. The index is saved next to the slab
+// when the cache is destroyed and dropped when it's loaded, so a crash only
+// loses the cached data. The slab lives in a directory only its user can
+// access and is locked while in use; a cache whose slab is locked by another
+// process or can't be kept private stays empty.
+class BlockCache {
+ public:
+  static constexpr uint64_t BLOCK_SIZE = 1024 * 1024;
+
+  BlockCache(const std::string& directory, const std::string& name,
+             uint64_t capacity);
+  ~BlockCache();
+
+  /**
+   * Key under which contents of the file are cached; it changes when the
+   * file is modified.
+   */
+  static std::string key(const std::string& provider, const std::string& id,
+                         uint64_t size,
+                         std::chrono::system_clock::time_point timestamp);
+
+  bool contains(const std::string& file, uint64_t offset, uint64_t size);
+
+  /**
+   * Reads [offset, offset + size) of the file if all of it is cached.
+   */
+  bool read(const std::string& file, uint64_t offset, uint64_t size,
+            Buffer& data);
+
+  /**
+   * Stores the blocks which data read from offset covers entirely; the last
+   * block of the file is shorter than BLOCK_SIZE.
+   */
+  void write(const std::string& file, uint64_t file_size, uint64_t offset,
+             const Buffer& data);
+
+ private:
+  struct Slot {
+    std::string key_;
+    uint64_t size_;
+    std::list<size_t>::iterator lru_;
+  };
+
+  template <class Visitor>
+  bool visit(const std::string& file, uint64_t offset, uint64_t size,
+             Visitor);
+  void insert(size_t slot, const std::string& key, uint64_t size);
+  void erase(size_t slot);
+  bool acquire(const std::string& directory);
+  void load();
+  void save();
+
+  std::mutex mutex_;
+  int lock_ = -1;
+  std::string name_;
+  std::string slab_filename_;
+  std::string index_filename_;
+  std::fstream slab_;
+  std::vector<Slot> slot_;
+  std::unordered_map<std::string, size_t> index_;
+  std::list<size_t> lru_;
+  std::vector<size_t> free_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // BLOCK_CACHE_H
@@ -0,0 +1,114 @@
+#include "Buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cloudstorage {
+
+namespace {
+
+const size_t MIN_BLOCK_SIZE = 64 * 1024;
+const size_t POOL_SIZE = 64 * 1024 * 1024;
+
+size_t block_size(size_t capacity) {
+  size_t size = MIN_BLOCK_SIZE;
+  while (size < capacity) size *= 2;
+  return size;
+}
+
+// Free blocks by their size, up to POOL_SIZE bytes in total.
+class Pool {
+ public:
+  std::unique_ptr<char[]> take(size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = free_.find(size);
+      if (it != free_.end() && !it->second.empty()) {
+        auto block = std::move(it->second.back());
+        it->second.pop_back();
+        free_size_ -= size;
+        return block;
+      }
+    }
+    return std::unique_ptr<char[]>(new char[size]);
+  }
+
+  void give(std::unique_ptr<char[]> block, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_size_ + size > POOL_SIZE) return;
+    free_[size].push_back(std::move(block));
+    free_size_ += size;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<size_t, std::vector<std::unique_ptr<char[]>>> free_;
+  size_t free_size_ = 0;
+};
+
+// Never destroyed, as blocks may be released during static destruction.
+Pool& pool() {
+  static auto pool = new Pool;
+  return *pool;
+}
+
+}  // namespace
+
+struct Buffer::Block {
+  explicit Block(size_t capacity)
+      : capacity_(block_size(capacity)),
+        size_(),
+        data_(pool().take(capacity_)) {}
+
+  ~Block() { pool().give(std::move(data_), capacity_); }
+
+  size_t capacity_;
+  size_t size_;
+  std::unique_ptr<char[]> data_;
+};
+
+Buffer::Buffer() : offset_(), size_() {}
+
+Buffer::Buffer(size_t capacity)
+    : block_(std::make_shared<Block>(capacity)), offset_(), size_() {}
+
+Buffer::Buffer(const std::string& data) : Buffer(data.size()) {
+  append(data.data(), data.size());
+}
+
+const char* Buffer::data() const {
+  return block_ ? block_->data_.get() + offset_ : nullptr;
+}
+
+size_t Buffer::size() const { return size_; }
+
+void Buffer::append(const char* data, size_t length) {
+  memcpy(extend(length), data, length);
+}
+
+char* Buffer::extend(size_t length) {
+  if (!block_ || offset_ + size_ != block_->size_ ||
+      block_->size_ + length > block_->capacity_) {
+    auto block = std::make_shared<Block>(std::max(2 * size_, size_ + length));
+    if (size_ > 0) memcpy(block->data_.get(), data(), size_);
+    block->size_ = size_;
+    block_ = std::move(block);
+    offset_ = 0;
+  }
+  auto position = block_->data_.get() + block_->size_;
+  block_->size_ += length;
+  size_ += length;
+  return position;
+}
+
+Buffer Buffer::substr(size_t offset, size_t length) const {
+  Buffer result = *this;
+  result.offset_ += std::min(offset, size_);
+  result.size_ = std::min(length, size_ - std::min(offset, size_));
+  return result;
+}
+
+}  // namespace cloudstorage
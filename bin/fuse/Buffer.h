@@ -0,0 +1,50 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cloudstorage {
+
+// View of a refcounted block of memory, which is taken from a pool and goes
+// back to it once no buffer references it. Copies and substr() share the
+// block, so file contents aren't copied on the way from the provider,
+// through the cache, to the reply.
+class Buffer {
+ public:
+  Buffer();
+
+  /**
+   * Creates an empty buffer which can grow to capacity bytes without
+   * reallocation.
+   */
+  explicit Buffer(size_t capacity);
+
+  explicit Buffer(const std::string& data);
+
+  const char* data() const;
+  size_t size() const;
+
+  void append(const char* data, size_t length);
+
+  /**
+   * Grows the buffer by length uninitialized bytes and returns where they
+   * start; the block is reallocated if it's too small or other buffers use
+   * it past the end of this one.
+   */
+  char* extend(size_t length);
+
+  Buffer substr(size_t offset, size_t length) const;
+
+ private:
+  struct Block;
+
+  std::shared_ptr<Block> block_;
+  size_t offset_;
+  size_t size_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // BUFFER_H
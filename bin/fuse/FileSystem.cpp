@@ -86,12 +86,57 @@ void FileSystem::Node::set_upload_request(std::shared_ptr<IGenericRequest> r) {
   upload_request_ = std::move(r);
 }
 
+FileSystem::Directory::Directory()
+    : timestamp_(std::chrono::system_clock::now()) {}
+
+bool FileSystem::Directory::insert(FileId node, const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto inserted = child_.insert({node, name}).second;
+  name_[name] = node;
+  return inserted;
+}
+
+void FileSystem::Directory::erase(FileId node) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = child_.find(node);
+  if (it == child_.end()) return;
+  auto name = name_.find(it->second);
+  if (name != name_.end() && name->second == node) name_.erase(name);
+  child_.erase(it);
+}
+
+IFileSystem::FileId FileSystem::Directory::find(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = name_.find(name);
+  return it != name_.end() ? it->second : 0;
+}
+
+std::vector<IFileSystem::FileId> FileSystem::Directory::children() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<FileId> result;
+  result.reserve(child_.size());
+  for (const auto& d : child_) result.push_back(d.first);
+  return result;
+}
+
+std::chrono::system_clock::time_point FileSystem::Directory::timestamp() const {
+  return timestamp_;
+}
+
 FileSystem::FileSystem(const std::vector<ProviderEntry>& provider,
-                       IHttp::Pointer http, std::string temporary_directory)
+                       IHttp::Pointer http, std::string temporary_directory,
+                       const std::string& block_cache_name,
+                       uint64_t block_cache_size, uint64_t max_read_ahead)
     : next_(1),
       running_(true),
       http_(std::move(http)),
       temporary_directory_(std::move(temporary_directory)),
+      block_cache_(block_cache_size > 0
+                       ? util::make_unique<BlockCache>(temporary_directory_,
+                                                       block_cache_name,
+                                                       block_cache_size)
+                       : nullptr),
+      max_read_ahead_(max_read_ahead),
       cancelled_request_thread_(std::async(
           std::launch::async, std::bind(&FileSystem::cancelled, this))),
       cleanup_(std::async(std::launch::async,
@@ -100,22 +145,26 @@ FileSystem::FileSystem(const std::vector<ProviderEntry>& provider,
       util::make_unique<cloudstorage::Item>("/", "root", IItem::UnknownSize,
                                             IItem::UnknownTimeStamp,
                                             IItem::FileType::Directory));
-  std::unordered_set<FileId> root_directory;
+  auto root_directory = std::make_shared<Directory>();
   for (auto&& entry : provider) {
     IItem::Pointer item = util::make_unique<cloudstorage::Item>(
         entry.label_, entry.provider_->rootDirectory()->id(),
         IItem::UnknownSize, IItem::UnknownTimeStamp,
         IItem::FileType::Directory);
     auto provider_id = add(entry.provider_, 1, item)->inode();
-    root_directory.insert(provider_id);
+    root_directory->insert(provider_id, sanitize(entry.label_));
+    provider_label_[entry.provider_.get()] = entry.label_;
     auth_node_[entry.label_] =
         add(entry.provider_, provider_id, auth_item(entry.provider_->name()))
             ->inode();
   }
-  node_directory_[1] = root_directory;
+  node_directory_.set(1, root_directory);
 }
 
 FileSystem::~FileSystem() {
+  // Streamed uploads of files which weren't flushed would wait forever.
+  for (const auto& node : node_map_.values())
+    if (node->write_back_) node->write_back_->abort();
   running_ = false;
   request_data_condition_.notify_one();
   cancelled_request_condition_.notify_one();
@@ -175,83 +224,63 @@ void FileSystem::add(RequestData r) {
 
 FileSystem::Node::Pointer FileSystem::add(std::shared_ptr<ICloudProvider> p,
                                           FileId parent, IItem::Pointer i) {
-  std::lock_guard<mutex> lock(node_data_mutex_);
-  auto it = node_id_map_.find(id(p, i));
-  if (it == std::end(node_id_map_)) {
+  return node_id_map_.find_or_insert(id(p, i), [&] {
     auto idx = next_++;
     auto node = std::make_shared<Node>(p, i, parent, idx, i->size());
-    node_map_[idx] = node;
-    node_id_map_[id(p, i)] = node;
-    if (parent > 0) {
-      auto parent_node = node_map_[parent];
-      node->path_ = parent_node->path_ + "/" + sanitize(i->filename());
-      node_path_to_id_[node->path_] = idx;
-    } else {
-      node_path_to_id_[""] = idx;
-    }
+    if (parent > 0)
+      node->path_ = get(parent)->path_ + "/" + sanitize(i->filename());
+    node_map_.set(idx, node);
+    node_path_to_id_.set(node->path_, idx);
     return node;
-  } else
-    return it->second;
+  });
 }
 
 void FileSystem::set(FileId idx, const Node::Pointer& node) {
-  std::lock_guard<mutex> lock(node_data_mutex_);
   if (node->item()) {
-    node_map_[idx] = node;
-    node_id_map_[id(node->provider(), node->item())] = node;
-    if (node->parent_ > 0) {
+    if (node->parent_ > 0)
       node->path_ =
-          node_map_[node->parent_]->path_ + "/" + sanitize(node->filename());
-      node_path_to_id_[node->path_] = idx;
-    } else {
-      node_path_to_id_[""] = idx;
-    }
+          get(node->parent_)->path_ + "/" + sanitize(node->filename());
+    node_map_.set(idx, node);
+    node_id_map_.set(id(node->provider(), node->item()), node);
+    node_path_to_id_.set(node->path_, idx);
   } else {
-    auto it1 = node_map_.find(idx);
-    if (it1 != std::end(node_map_)) {
-      auto it2 =
-          node_id_map_.find(id(it1->second->provider(), it1->second->item()));
-      if (it2 != std::end(node_id_map_)) node_id_map_.erase(it2);
-      node_map_.erase(it1);
+    if (auto previous = node_map_.erase(idx)) {
+      node_id_map_.erase(id(previous->provider(), previous->item()));
+      node_path_to_id_.erase(previous->path_, idx);
     }
-    auto it3 = node_directory_.find(idx);
-    if (it3 != std::end(node_directory_)) node_directory_.erase(it3);
-    auto it4 = node_path_to_id_.find(node->path_);
-    if (it4 != node_path_to_id_.end()) node_path_to_id_.erase(it4);
+    node_directory_.erase(idx);
   }
 }
 
 IFileSystem::FileId FileSystem::mknod(FileId parent, const char* name) {
-  std::lock_guard<mutex> lock(node_data_mutex_);
   auto p = get(parent);
   if (!p->provider()) return 0;
   auto node = add(p->provider(), parent,
                   std::make_shared<Item>(name, "", 0, IItem::UnknownTimeStamp,
                                          IItem::FileType::Unknown));
-  node->cache_filename_ =
-      temporary_directory_ + "cloudstorage" + std::to_string(node->inode());
-  node->store_ = util::make_unique<std::fstream>(
-      node->cache_filename_,
-      std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
-  {
-    std::lock_guard<mutex> lock(node_data_mutex_);
-    auto it = node_directory_.find(node->parent_);
-    if (it != node_directory_.end()) it->second.insert(node->inode());
-  }
+  node->write_back_ = std::make_shared<WriteBack>(
+      WRITE_BACK_WINDOW,
+      temporary_directory_ + "cloudstorage" + std::to_string(node->inode()));
+  if (auto directory = node_directory_.find(node->parent_))
+    directory->insert(node->inode(), sanitize(name));
   return node->inode();
 }
 
 FileSystem::Node::Pointer FileSystem::get(FileId node) {
-  std::unique_lock<mutex> lock(node_data_mutex_);
-  auto it = node_map_.find(node);
-  if (it == node_map_.end())
-    return std::make_shared<Node>();
-  else
-    return it->second;
+  auto result = node_map_.find(node);
+  return result ? result : std::make_shared<Node>();
 }
 
 void FileSystem::lookup(FileId parent_node, const std::string& name,
                         GetItemCallback cb) {
+  if (auto directory = node_directory_.find(parent_node)) {
+    auto node = directory->find(name);
+    if (node)
+      cb(std::static_pointer_cast<INode>(get(node)));
+    else
+      cb(Error{IHttpRequest::Bad, "not found"});
+    return list_directory(parent_node, true, ListDirectoryCallback());
+  }
   readdir(parent_node, [=](EitherError<INode::List> e) {
     if (auto lst = e.right()) {
       for (auto&& i : *lst)
@@ -310,17 +339,15 @@ void FileSystem::getattr(FileId node, GetItemCallback cb) {
 
 void FileSystem::getattr(const std::string& full_path,
                          GetItemCallback callback) {
-  std::unique_lock<mutex> lock(node_data_mutex_);
   std::string path = full_path;
   if (!path.empty() && path.back() == '/') {
     path.pop_back();
   }
-  auto it = node_path_to_id_.find(path);
-  if (it == node_path_to_id_.end()) {
-    lock.unlock();
+  auto node = node_path_to_id_.find(path);
+  if (node == 0) {
     callback(Error{IHttpRequest::NotFound, "file not found"});
   } else {
-    getattr(it->second, callback);
+    getattr(node, callback);
   }
 }
 
@@ -342,7 +369,25 @@ void FileSystem::write(FileId inode, const char* data, uint32_t size,
   getattr(inode, [=](EitherError<INode> e) {
     if (e.left()) return callback(0);
     auto n = static_cast<Node*>(e.right().get());
+    auto parent = get(n->parent_);
     std::lock_guard<mutex> lock(n->mutex_);
+    util::log("writing", e.right()->filename(), offset, "-", offset + size - 1);
+    if (n->write_back_) {
+      if (!n->upload_request_) {
+        std::shared_ptr<IGenericRequest> request =
+            n->provider()->uploadFileStreamAsync(parent->item(), n->filename(),
+                                                 n->write_back_);
+        if (request) {
+          n->set_upload_request(request);
+          add({n->provider(), request});
+        }
+      }
+      if (n->upload_request_ &&
+          n->write_back_->write(data, size, offset, callback))
+        return;
+      if (!stop_write_back(*n))
+        return callback(Error{IHttpRequest::Bad, util::Error::INVALID_RANGE});
+    }
     if (!n->store_) {
       n->cache_filename_ =
           temporary_directory_ + "cloudstorage" + std::to_string(n->inode());
@@ -350,7 +395,6 @@ void FileSystem::write(FileId inode, const char* data, uint32_t size,
           n->cache_filename_,
           std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
     }
-    util::log("writing", e.right()->filename(), offset, "-", offset + size - 1);
     n->store_->seekp(offset);
     n->store_->write(data, size);
     if (!n->store_)
@@ -361,27 +405,26 @@ void FileSystem::write(FileId inode, const char* data, uint32_t size,
 }
 
 void FileSystem::readdir(FileId node, ListDirectoryCallback cb) {
-  bool reported = false;
-  {
-    std::unique_lock<mutex> lock(node_data_mutex_);
-    auto it = node_directory_.find(node);
-    if (it != std::end(node_directory_)) {
-      INode::List ret;
-      for (auto&& r : it->second) ret.push_back(get(r));
-      reported = true;
-      lock.unlock();
-      cb(ret);
-    }
+  auto directory = node_directory_.find(node);
+  if (directory) {
+    INode::List ret;
+    for (auto&& r : directory->children()) ret.push_back(get(r));
+    cb(ret);
   }
+  list_directory(node, directory != nullptr, cb);
+}
+
+void FileSystem::list_directory(FileId node, bool reported,
+                                ListDirectoryCallback cb) {
   auto nd = get(node);
   if (nd->provider() == nullptr && !reported)
     return cb(Error{IHttpRequest::Bad, ""});
   std::unique_lock<std::recursive_mutex> lock(nd->mutex_);
   if (reported) {
     if (nd->list_directory_pending_) return;
-    auto it = node_timestamp_.find(node);
-    if (it != node_timestamp_.end() &&
-        std::chrono::system_clock::now() - it->second <=
+    auto directory = node_directory_.find(node);
+    if (directory &&
+        std::chrono::system_clock::now() - directory->timestamp() <=
             CACHE_DIRECTORY_DURATION) {
       return;
     }
@@ -391,21 +434,17 @@ void FileSystem::readdir(FileId node, ListDirectoryCallback cb) {
   list_directory_async(
       nd->provider(), nd->item(), [=](EitherError<IItem::List> e) {
         if (auto lst = e.right()) {
-          std::unordered_set<FileId> ret;
+          auto directory = std::make_shared<Directory>();
+          INode::List nodes;
           for (auto&& i : *lst)
             if (i->type() == IItem::FileType::Directory ||
-                i->size() != IItem::UnknownSize || !IGNORE_UNKNOWN_SIZE)
-              ret.insert(this->add(nd->provider(), node, i)->inode());
-          {
-            std::lock_guard<mutex> lock(node_data_mutex_);
-            node_directory_[node] = ret;
-            node_timestamp_[node] = std::chrono::system_clock::now();
-          }
-          if (!reported) {
-            INode::List nodes;
-            for (auto&& r : ret) nodes.push_back(this->get(r));
-            cb(nodes);
-          }
+                i->size() != IItem::UnknownSize || !IGNORE_UNKNOWN_SIZE) {
+              auto child = this->add(nd->provider(), node, i);
+              if (directory->insert(child->inode(), sanitize(i->filename())))
+                nodes.push_back(child);
+            }
+          node_directory_.set(node, directory);
+          if (!reported) cb(nodes);
         } else {
           if (!reported) {
             auto item = auth_item(nd->provider()->authorizeLibraryUrl());
@@ -428,13 +467,12 @@ void FileSystem::read(FileId node, size_t offset, size_t sz,
     if (e.left()) return cb(e.left());
     auto nd = std::static_pointer_cast<Node>(e.right());
     if (nd->size() == IItem::UnknownSize || nd->size() == 0 || !nd->provider())
-      return cb(std::string());
+      return cb(Buffer());
     if (nd->item()->id() == AUTH_ITEM_ID) {
       auto data = authorize_file(nd->provider()->authorizeLibraryUrl());
       auto start = std::min<size_t>(offset, data.size() - 1);
       auto size = std::min<size_t>(data.size() - start, sz);
-      auto d = data.substr(start, size);
-      return cb(d);
+      return cb(Buffer(data.substr(start, size)));
     }
     auto fit = [=](Range r) {
       r.start_ =
@@ -445,19 +483,26 @@ void FileSystem::read(FileId node, size_t offset, size_t sz,
     };
     Range range = fit({offset, sz});
     std::unique_lock<mutex> lock(nd->mutex_);
+    auto cache_key = block_cache_key(*nd);
+    auto cached = [=](Range r) {
+      r = fit(r);
+      return !cache_key.empty() &&
+             block_cache_->contains(cache_key, r.start_, r.size_);
+    };
     auto inside = [=](Range r1, Range r2) {
       r1 = fit(r1);
       r2 = fit(r2);
       return r1.start_ >= r2.start_ &&
              r1.start_ + r1.size_ <= r2.start_ + r2.size_;
     };
-    auto download = [=](Range range) {
+    auto download = [=](Range range, bool read_ahead) {
       for (auto&& download_range : nd->pending_download_)
         if (inside(range, download_range)) return;
       range = fit({range.start_, std::max<size_t>(range.size_, READ_AHEAD)});
       nd->pending_download_.push_back(range);
       download_item_async(
-          nd->provider(), nd->item(), range, [=](EitherError<std::string> e) {
+          nd->provider(), nd->item(), range, read_ahead,
+          [=](EitherError<Buffer> e) {
             std::unique_lock<mutex> lock(nd->mutex_);
             auto requests = nd->read_request_;
             for (auto&& read : requests)
@@ -476,36 +521,94 @@ void FileSystem::read(FileId node, size_t offset, size_t sz,
             if (it != nd->pending_download_.end())
               nd->pending_download_.erase(it);
             if (e.right()) {
-              nd->chunk_.push_back({range, std::move(*e.right())});
-              if (nd->chunk_.size() >= CACHED_CHUNK_COUNT)
+              if (!cache_key.empty())
+                block_cache_->write(cache_key, nd->size(), range.start_,
+                                    *e.right());
+              nd->chunk_.push_back({range, *e.right()});
+              if (nd->chunk_.size() >=
+                  CACHED_CHUNK_COUNT + max_read_ahead_ / READ_AHEAD)
                 nd->chunk_.pop_front();
             }
           });
     };
-    bool read_ahead = true;
-    for (auto&& chunk : nd->chunk_)
-      if (inside(Range{range.start_ + READ_AHEAD / 2, READ_AHEAD / 2},
-                 chunk.range_))
-        read_ahead = false;
-    if (read_ahead) download(Range{range.start_ + READ_AHEAD / 2, range.size_});
+    auto in_memory = [=](Range r) {
+      for (auto&& chunk : nd->chunk_)
+        if (inside(r, chunk.range_)) return true;
+      return false;
+    };
+    auto read_end = range.start_ + range.size_;
+    if (range.start_ + READ_AHEAD >= nd->next_read_ &&
+        range.start_ <= nd->next_read_ + READ_AHEAD) {
+      nd->read_ahead_window_ = std::min(
+          std::max<uint64_t>(2 * nd->read_ahead_window_, READ_AHEAD),
+          max_read_ahead_);
+      nd->next_read_ = std::max<uint64_t>(nd->next_read_, read_end);
+    } else {
+      nd->read_ahead_window_ = 0;
+      nd->read_ahead_end_ = 0;
+      nd->next_read_ = read_end;
+    }
+    Buffer data;
+    bool available = false;
     for (auto&& chunk : nd->chunk_)
-      if (inside(range, chunk.range_))
-        return cb(chunk.data_.substr(range.start_ - chunk.range_.start_,
-                                     range.size_));
-    nd->read_request_.push_back({range, cb});
-    download(range);
+      if (!available && inside(range, chunk.range_)) {
+        data = chunk.data_.substr(range.start_ - chunk.range_.start_,
+                                  range.size_);
+        available = true;
+      }
+    if (!available && !cache_key.empty())
+      available =
+          block_cache_->read(cache_key, range.start_, range.size_, data);
+    if (!available) {
+      nd->read_request_.push_back({range, cb});
+      download(range, false);
+      read_end = std::max<uint64_t>(read_end, range.start_ + READ_AHEAD);
+    }
+    // Windows of the read-ahead are downloaded in parallel.
+    auto ahead = std::max<uint64_t>(nd->read_ahead_end_, read_end);
+    auto ahead_end =
+        std::min<uint64_t>(range.start_ + range.size_ + nd->read_ahead_window_,
+                           nd->size());
+    for (; ahead < ahead_end; ahead += READ_AHEAD) {
+      Range window = fit({ahead, READ_AHEAD});
+      if (!in_memory(window) && !cached(window)) download(window, true);
+    }
+    nd->read_ahead_end_ = std::max(nd->read_ahead_end_, ahead);
+    if (available) cb(data);
   });
 }
 
+bool FileSystem::stop_write_back(Node& node) {
+  auto store = node.write_back_->store();
+  node.write_back_ = nullptr;
+  if (node.upload_request_) {
+    cancel(node.upload_request_);
+    node.set_upload_request(nullptr);
+  }
+  if (!store) return false;
+  node.cache_filename_ =
+      temporary_directory_ + "cloudstorage" + std::to_string(node.inode());
+  node.store_ = std::move(store);
+  return true;
+}
+
+std::string FileSystem::block_cache_key(const Node& node) const {
+  if (!block_cache_ || node.store_ || !node.item() || !node.provider() ||
+      node.item()->id().empty() ||
+      node.item()->timestamp() == IItem::UnknownTimeStamp)
+    return "";
+  auto label = provider_label_.find(node.provider().get());
+  if (label == provider_label_.end()) return "";
+  return BlockCache::key(label->second, node.item()->id(), node.size(),
+                         node.item()->timestamp());
+}
+
 void FileSystem::invalidate(FileId root) {
-  std::lock_guard<mutex> lock(node_data_mutex_);
-  auto it = node_directory_.find(root);
-  if (it != node_directory_.end()) {
-    for (auto&& n : it->second) {
+  if (auto directory = node_directory_.erase(root)) {
+    for (auto&& n : directory->children()) {
       invalidate(n);
       set(n, std::make_shared<Node>());
     }
-    node_directory_.erase(it);
   }
 }
 
@@ -533,14 +636,11 @@ void FileSystem::rename(FileId parent, const char* name, FileId newparent,
         p, node->item(), parent_item, destination_item, newname,
         [=](EitherError<IItem> e) {
           if (e.right()) {
-            std::lock_guard<mutex> lock(node_data_mutex_);
             this->invalidate(node->inode());
-            auto& old_lst = node_directory_[parent];
-            auto it = old_lst.find(node->inode());
-            if (it != std::end(old_lst)) old_lst.erase(it);
-            auto nit = node_directory_.find(newparent);
-            if (nit != std::end(node_directory_))
-              nit->second.insert(node->inode());
+            if (auto directory = node_directory_.find(parent))
+              directory->erase(node->inode());
+            if (auto directory = node_directory_.find(newparent))
+              directory->insert(node->inode(), sanitize(e.right()->filename()));
             this->set(node->inode(),
                       std::make_shared<Node>(p, e.right(), node->parent_,
                                              node->inode(), node->size()));
@@ -554,15 +654,15 @@ void FileSystem::remove(FileId parent, const char* name,
                         DeleteItemCallback callback) {
   util::log("removing", name);
   auto update_lists = [=](Node::Pointer node) {
-    std::lock_guard<mutex> lock(node_data_mutex_);
-    auto it = node_directory_.find(parent);
-    if (it != node_directory_.end()) {
-      auto d = it->second.find(node->inode());
-      if (d != it->second.end()) it->second.erase(d);
-    }
+    if (auto directory = node_directory_.find(parent))
+      directory->erase(node->inode());
   };
   auto remove_file = [=](Node::Pointer node) {
-    std::lock_guard<mutex> lock(node_data_mutex_);
+    {
+      // The streamed upload waits for data which won't come.
+      std::lock_guard<mutex> lock(node->mutex_);
+      if (node->write_back_) node->write_back_->abort();
+    }
     if (node->upload_request()) {
       this->cancel(node->upload_request());
       update_lists(node);
@@ -599,7 +699,20 @@ void FileSystem::fsync(FileId inode, DataSynchronizedCallback cb) {
   auto p = parent_node->provider();
   if (!p) return cb(Error{IHttpRequest::ServiceUnavailable, ""});
   {
-    std::lock_guard<mutex> lock(node->mutex_);
+    std::unique_lock<mutex> lock(node->mutex_);
+    if (node->write_back_ && !node->upload_request_ &&
+        !stop_write_back(*node))
+      return cb(Error{IHttpRequest::Bad, util::Error::INVALID_RANGE});
+    if (auto write_back = node->write_back_) {
+      lock.unlock();
+      return write_back->finish([=](EitherError<IItem> e) {
+        if (e.left()) return cb(e.left());
+        set(inode, std::make_shared<Node>(p, e.right(), node->parent_, inode,
+                                          e.right()->size()));
+        log("fsynced", node->filename());
+        cb(nullptr);
+      });
+    }
     if (!node->store_) return cb(nullptr);
   }
   class UploadCallback : public IUploadFileCallback {
@@ -625,7 +738,6 @@ void FileSystem::fsync(FileId inode, DataSynchronizedCallback cb) {
 
     void done(EitherError<IItem> e) override {
       if (e.left()) return callback_(e.left());
-      std::lock_guard<mutex> lock(fuse_->node_data_mutex_);
       fuse_->set(node_->inode_,
                  std::make_shared<Node>(provider_, e.right(), node_->parent_,
                                         node_->inode_, e.right()->size()));
@@ -634,10 +746,7 @@ void FileSystem::fsync(FileId inode, DataSynchronizedCallback cb) {
     }
 
     void progress(uint64_t, uint64_t now) override {
-      std::lock_guard<mutex> lock(fuse_->node_data_mutex_);
-      auto node = fuse_->get(node_->inode_);
-      node->set_size(now);
-      fuse_->set(node_->inode_, node);
+      fuse_->get(node_->inode_)->set_size(now);
     }
 
    private:
@@ -664,10 +773,9 @@ void FileSystem::mkdir(FileId parent, const char* name,
   add({p,
        p->createDirectoryAsync(node->item(), name, [=](EitherError<IItem> e) {
          if (e.left()) return callback(e.left());
-         std::lock_guard<mutex> lock(node_data_mutex_);
          auto node = this->add(p, parent, e.right());
-         auto it = node_directory_.find(parent);
-         if (it != node_directory_.end()) it->second.insert(node->inode());
+         if (auto directory = node_directory_.find(parent))
+           directory->insert(node->inode(), sanitize(e.right()->filename()));
          callback(std::static_pointer_cast<INode>(node));
        })});
 }
@@ -705,15 +813,19 @@ void FileSystem::list_directory_async(
 
 void FileSystem::download_item_async(const std::shared_ptr<ICloudProvider>& p,
                                      const IItem::Pointer& item, Range range,
+                                     bool background,
                                      const DownloadItemCallback& cb) {
   if (!p || !item) return cb(Error{IHttpRequest::ServiceUnavailable, ""});
   class Callback : public IDownloadFileCallback {
    public:
-    Callback(const DownloadItemCallback& cb)
-        : start_(std::chrono::system_clock::now()), callback_(cb) {}
+    Callback(const DownloadItemCallback& cb, size_t size, bool background)
+        : start_(std::chrono::system_clock::now()),
+          buffer_(size),
+          callback_(cb),
+          background_(background) {}
 
     void receivedData(const char* data, uint32_t length) override {
-      buffer_ += std::string(data, length);
+      buffer_.append(data, length);
     }
 
     void done(EitherError<void> e) override {
@@ -726,14 +838,19 @@ void FileSystem::download_item_async(const std::shared_ptr<ICloudProvider>& p,
 
     void progress(uint64_t, uint64_t) override {}
 
+    bool background() override { return background_; }
+
    private:
     std::chrono::system_clock::time_point start_;
-    std::string buffer_;
+    Buffer buffer_;
     DownloadItemCallback callback_;
+    bool background_;
   };
   log("requesting", item->filename(), range.start_, "-",
       range.start_ + range.size_ - 1);
-  add({p, p->downloadFileAsync(item, util::make_unique<Callback>(cb), range)});
+  add({p, p->downloadFileAsync(
+                 item, util::make_unique<Callback>(cb, range.size_, background),
+                 range)});
 }
 
 void FileSystem::get_url_async(const std::shared_ptr<ICloudProvider>& p,
@@ -757,8 +874,11 @@ std::string FileSystem::sanitize(const std::string& name) {
 
 IFileSystem::Pointer IFileSystem::create(
     const std::vector<ProviderEntry>& p, IHttp::Pointer http,
-    const std::string& temporary_directory) {
-  return util::make_unique<FileSystem>(p, std::move(http), temporary_directory);
+    const std::string& temporary_directory, const std::string& block_cache_name,
+    uint64_t block_cache_size, uint64_t max_read_ahead) {
+  return util::make_unique<FileSystem>(p, std::move(http), temporary_directory,
+                                       block_cache_name, block_cache_size,
+                                       max_read_ahead);
 }
 
 }  // namespace cloudstorage
@@ -10,16 +10,20 @@
 #include <iostream>
 #include <mutex>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
+#include "BlockCache.h"
 #include "ICloudStorage.h"
 #include "IFileSystem.h"
+#include "ShardedMap.h"
+#include "WriteBack.h"
 #include "Utility/Utility.h"
 
 namespace cloudstorage {
 
 const int READ_AHEAD = 2 * 1024 * 1024;
 const int CACHED_CHUNK_COUNT = 4;
+const uint64_t WRITE_BACK_WINDOW = 64 * 1024 * 1024;
 const auto CACHE_DIRECTORY_DURATION = std::chrono::seconds(60);
 
 class FileSystem : public IFileSystem {
@@ -52,7 +56,7 @@ class FileSystem : public IFileSystem {
 
     struct Chunk {
       Range range_;
-      std::string data_;
+      Buffer data_;
     };
 
     struct ReadRequest {
@@ -67,19 +71,30 @@ class FileSystem : public IFileSystem {
     IItem::Pointer item_;
     FileId parent_;
     FileId inode_;
-    uint64_t size_;
+    // Updated in place by upload progress while the node is published.
+    std::atomic<uint64_t> size_;
     std::shared_ptr<IGenericRequest> upload_request_;
     std::vector<ReadRequest> read_request_;
     std::vector<Range> pending_download_;
     std::deque<Chunk> chunk_;
+    // Sequential reads double the read-ahead window, a seek drops it.
+    uint64_t next_read_ = 0;
+    uint64_t read_ahead_window_ = 0;
+    uint64_t read_ahead_end_ = 0;
     std::string cache_filename_;
+    // Assigned before the node is published, never changed afterwards.
     std::string path_;
     std::unique_ptr<std::fstream> store_;
+    // New files are streamed to the provider until they're written randomly,
+    // then they are stored in a temporary file.
+    WriteBack::Pointer write_back_;
     bool list_directory_pending_ = false;
   };
 
   FileSystem(const std::vector<ProviderEntry> &, IHttp::Pointer http,
-             std::string temporary_directory);
+             std::string temporary_directory,
+             const std::string &block_cache_name, uint64_t block_cache_size,
+             uint64_t max_read_ahead);
   ~FileSystem() override;
 
   FileId mknod(FileId parent, const char *name) override;
@@ -100,6 +115,27 @@ class FileSystem : public IFileSystem {
   std::string sanitize(const std::string &) override;
 
  private:
+  // Children of a listed directory; they're looked up by their sanitized
+  // names without going through the whole list.
+  class Directory {
+   public:
+    using Pointer = std::shared_ptr<Directory>;
+
+    Directory();
+
+    bool insert(FileId, const std::string &name);
+    void erase(FileId);
+    FileId find(const std::string &name) const;
+    std::vector<FileId> children() const;
+    std::chrono::system_clock::time_point timestamp() const;
+
+   private:
+    mutable std::mutex mutex_;
+    std::unordered_map<FileId, std::string> child_;
+    std::unordered_map<std::string, FileId> name_;
+    std::chrono::system_clock::time_point timestamp_;
+  };
+
   struct RequestData {
     std::shared_ptr<ICloudProvider> provider_;
     std::shared_ptr<IGenericRequest> request_;
@@ -109,11 +145,17 @@ class FileSystem : public IFileSystem {
   Node::Pointer add(std::shared_ptr<ICloudProvider>, FileId parent,
                     IItem::Pointer);
 
+  // Publishes a freshly built node, existing nodes are never passed back in.
   void set(FileId, const Node::Pointer &);
 
   Node::Pointer get(FileId node);
+  void list_directory(FileId node, bool reported, ListDirectoryCallback);
   void get_path(FileId node, const std::string &path, const GetItemCallback &);
 
+  std::string block_cache_key(const Node &) const;
+  // Moves the streamed file to a temporary file, false if it's incomplete.
+  bool stop_write_back(Node &);
+
   void invalidate(FileId);
   void cleanup();
   void cancelled();
@@ -123,7 +165,7 @@ class FileSystem : public IFileSystem {
                             const IItem::Pointer &,
                             const cloudstorage::ListDirectoryCallback &);
   void download_item_async(const std::shared_ptr<ICloudProvider> &,
-                           const IItem::Pointer &, Range,
+                           const IItem::Pointer &, Range, bool background,
                            const DownloadItemCallback &);
   void get_url_async(const std::shared_ptr<ICloudProvider> &,
                      const IItem::Pointer &, const GetItemUrlCallback &);
@@ -132,21 +174,23 @@ class FileSystem : public IFileSystem {
                     const IItem::Pointer &destination, const char *name,
                     const RenameItemCallback &);
 
-  mutable mutex node_data_mutex_;
   mutable mutex request_data_mutex_;
-  std::unordered_map<std::string, FileId> node_path_to_id_;
-  std::unordered_map<FileId, Node::Pointer> node_map_;
-  std::unordered_map<std::string, Node::Pointer> node_id_map_;
-  std::unordered_map<FileId, std::unordered_set<FileId>> node_directory_;
-  std::unordered_map<FileId, std::chrono::system_clock::time_point>
-      node_timestamp_;
+  // Node tables are sharded, so that lookups of different files don't wait
+  // for each other.
+  ShardedMap<std::string, FileId> node_path_to_id_;
+  ShardedMap<FileId, Node::Pointer> node_map_;
+  ShardedMap<std::string, Node::Pointer> node_id_map_;
+  ShardedMap<FileId, Directory::Pointer> node_directory_;
   std::unordered_map<std::string, FileId> auth_node_;
-  FileId next_;
+  std::unordered_map<ICloudProvider *, std::string> provider_label_;
+  std::atomic<FileId> next_;
   std::deque<RequestData> request_data_;
   std::deque<std::shared_ptr<IGenericRequest>> cancelled_request_;
   std::atomic_bool running_;
   IHttp::Pointer http_;
   std::string temporary_directory_;
+  std::unique_ptr<BlockCache> block_cache_;
+  uint64_t max_read_ahead_;
   std::condition_variable_any cancelled_request_condition_;
   std::condition_variable_any request_data_condition_;
   std::future<void> cancelled_request_thread_;
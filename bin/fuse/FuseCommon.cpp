@@ -18,6 +18,9 @@ namespace cloudstorage {
 
 namespace {
 
+const uint64_t DEFAULT_BLOCK_CACHE_SIZE = 512 * 1024 * 1024;
+const unsigned DEFAULT_READ_AHEAD_MB = 16;
+
 #define OPTION(t, p) \
   { t, offsetof(struct options, p), 1 }
 
@@ -34,12 +37,14 @@ struct options {
   char *add_provider_label;
   char *remove_provider_label;
   int list_providers;
+  unsigned read_ahead;
 };
 
 const struct fuse_opt option_spec[] = {
     OPTION("--config=%s", config_file), OPTION("--add=%s", add_provider_label),
     OPTION("--remove=%s", remove_provider_label),
-    OPTION("--list", list_providers), FUSE_OPT_END};
+    OPTION("--list", list_providers), OPTION("--readahead=%u", read_ahead),
+    FUSE_OPT_END};
 }  // namespace
 
 std::string to_string(const std::wstring &str) {
@@ -72,6 +77,10 @@ IHttpRequest::Pointer HttpWrapper::create(const std::string &url,
   return http_->create(url, method, follow_redirect);
 }
 
+std::unordered_map<std::string, uint32_t> HttpWrapper::streamCount() const {
+  return http_->streamCount();
+}
+
 void ThreadPoolWrapper::schedule(
     const Task &f, const std::chrono::system_clock::time_point &when) {
   thread_pool_->schedule(f, when);
@@ -149,7 +158,8 @@ std::vector<IFileSystem::ProviderEntry> providers(
 }
 
 template <class Backend>
-int fuse_run(fuse_args *args, fuse_cmdline_opts *opts, Json::Value &json) {
+int fuse_run(fuse_args *args, fuse_cmdline_opts *opts, uint64_t read_ahead,
+             Json::Value &json) {
   if (!opts->mountpoint) {
     std::cerr << "missing mountpoint\n";
     return 1;
@@ -167,8 +177,15 @@ int fuse_run(fuse_args *args, fuse_cmdline_opts *opts, Json::Value &json) {
     temporary_directory = util::temporary_directory();
   auto p = providers(json["providers"], http_server_factory, http, thread_pool,
                      temporary_directory);
+  auto block_cache_size = json.isMember("block_cache_size")
+                              ? json["block_cache_size"].asUInt64()
+                              : DEFAULT_BLOCK_CACHE_SIZE;
+  // Each mount point gets a cache of its own.
+  auto block_cache_name =
+      "blocks-" + std::to_string(std::hash<std::string>()(opts->mountpoint));
   *ctx = IFileSystem::create(p, util::make_unique<HttpWrapper>(http),
-                             temporary_directory)
+                             temporary_directory, block_cache_name,
+                             block_cache_size, read_ahead)
              .release();
   int ret = fuse.run(opts->singlethread, opts->clone_fd);
   for (size_t i = 0; i < p.size(); i++) {
@@ -188,6 +205,7 @@ int fuse_run(int argc, char **argv) {
                             delete e;
                           });
   struct options options {};
+  options.read_ahead = DEFAULT_READ_AHEAD_MB;
   if (fuse_opt_parse(args.get(), &options, option_spec, nullptr) == -1)
     return 1;
   if (!options.config_file)
@@ -208,6 +226,10 @@ int fuse_run(int argc, char **argv) {
     std::cerr << "    --config=config_path   path to configuration file\n";
     std::cerr << "                           (default: "
                  "~/.libcloudstorage-fuse.json)\n";
+    std::cerr << "    --readahead=size       maximum read-ahead of sequential "
+                 "reads in MiB\n";
+    std::cerr << "                           (default: "
+              << DEFAULT_READ_AHEAD_MB << ")\n";
     std::cerr << "\n";
     fuse_cmdline_help();
 #ifdef WITH_FUSE
@@ -297,16 +319,17 @@ int fuse_run(int argc, char **argv) {
     return 0;
   }
   int ret = 0;
+  uint64_t read_ahead = uint64_t(options.read_ahead) * 1024 * 1024;
 
 #ifdef WITH_WINFSP
-  ret = fuse_run<FuseWinFsp>(args.get(), opts.get(), json);
+  ret = fuse_run<FuseWinFsp>(args.get(), opts.get(), read_ahead, json);
 #elif WITH_DOKAN
-  ret = fuse_run<FuseDokan>(args.get(), opts.get(), json);
+  ret = fuse_run<FuseDokan>(args.get(), opts.get(), read_ahead, json);
 #else
 #ifdef FUSE_LOWLEVEL
-  ret = fuse_run<FuseLowLevel>(args.get(), opts.get(), json);
+  ret = fuse_run<FuseLowLevel>(args.get(), opts.get(), read_ahead, json);
 #else
-  ret = fuse_run<FuseHighLevel>(args.get(), opts.get(), json);
+  ret = fuse_run<FuseHighLevel>(args.get(), opts.get(), read_ahead, json);
 #endif
 #endif
 
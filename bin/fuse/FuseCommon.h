@@ -59,6 +59,7 @@ class HttpWrapper : public IHttp {
   IHttpRequest::Pointer create(const std::string &url,
                                const std::string &method,
                                bool follow_redirect) const override;
+  std::unordered_map<std::string, uint32_t> streamCount() const override;
 
  private:
   std::shared_ptr<IHttp> http_;
@@ -170,11 +170,11 @@ NTSTATUS read_file(DOKAN_READ_FILE_EVENT *e) {
     }
     context()->read(
         d.right()->inode(), e->Offset, e->NumberOfBytesToRead,
-        [=](EitherError<std::string> d) {
+        [=](EitherError<Buffer> d) {
           if (d.left()) {
             return DokanEndDispatchRead(e, STATUS_INTERNAL_ERROR);
           }
-          e->NumberOfBytesRead = static_cast<DWORD>(d.right()->length());
+          e->NumberOfBytesRead = static_cast<DWORD>(d.right()->size());
           memcpy(e->Buffer, d.right()->data(), e->NumberOfBytesRead);
           DokanEndDispatchRead(e, STATUS_SUCCESS);
         });
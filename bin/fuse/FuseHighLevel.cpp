@@ -78,7 +78,7 @@ int read(const char *path, char *buffer, size_t size, FUSE_OFF_T offset,
   ctx->getattr(path, [&](EitherError<IFileSystem::INode> e) {
     if (e.left()) return ret.set_value(-ENOENT);
     ctx->read(e.right()->inode(), offset, size,
-              [&](EitherError<std::string> e) {
+              [&](EitherError<Buffer> e) {
                 if (e.left()) return ret.set_value(-EIO);
                 memcpy(buffer, e.right()->data(), e.right()->size());
                 ret.set_value(static_cast<int>(e.right()->size()));
@@ -58,9 +58,12 @@ void flush(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *f) {
 
 void read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
           struct fuse_file_info *) {
-  context(req)->read(ino, off, size, [=](EitherError<std::string> e) {
+  context(req)->read(ino, off, size, [=](EitherError<Buffer> e) {
     if (auto data = e.right()) {
-      fuse_reply_buf(req, data->data(), data->size());
+      // Sent straight from the cached block.
+      fuse_bufvec buffer = FUSE_BUFVEC_INIT(data->size());
+      buffer.buf[0].mem = const_cast<char *>(data->data());
+      fuse_reply_data(req, &buffer, fuse_buf_copy_flags());
     } else {
       log("read:", e.left()->code_, e.left()->description_);
       fuse_reply_err(req, ENOENT);
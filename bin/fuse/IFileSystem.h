@@ -4,6 +4,7 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include "Buffer.h"
 #include "ICloudProvider.h"
 #include "IItem.h"
 #include "IRequest.h"
@@ -35,7 +36,7 @@ class IFileSystem {
 
   using ListDirectoryCallback = GenericCallback<EitherError<INode::List>>;
   using GetItemCallback = GenericCallback<EitherError<INode>>;
-  using DownloadItemCallback = GenericCallback<EitherError<std::string>>;
+  using DownloadItemCallback = GenericCallback<EitherError<Buffer>>;
   using WriteDataCallback = GenericCallback<EitherError<uint32_t>>;
   using DataSynchronizedCallback = GenericCallback<EitherError<void>>;
 
@@ -46,9 +47,18 @@ class IFileSystem {
 
   virtual ~IFileSystem() = default;
 
+  /**
+   * Downloaded data is kept in a block cache of block_cache_size bytes, named
+   * block_cache_name in a private directory under temporary_directory; 0
+   * disables it. Sequential reads are prefetched up to max_read_ahead bytes
+   * ahead.
+   */
   static IFileSystem::Pointer create(const std::vector<ProviderEntry> &,
                                      IHttp::Pointer http,
-                                     const std::string &temporary_directory);
+                                     const std::string &temporary_directory,
+                                     const std::string &block_cache_name,
+                                     uint64_t block_cache_size,
+                                     uint64_t max_read_ahead);
 
   virtual std::string sanitize(const std::string &filename) = 0;
 
@@ -0,0 +1,99 @@
+#ifndef SHARDED_MAP_H
+#define SHARDED_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudstorage {
+
+// Hash map split into shards locked separately, so that threads working with
+// different keys rarely wait for each other. Values are returned by copy and
+// no callback runs with a shard locked, except for find_or_insert's factory.
+template <class Key, class Value, size_t ShardCount = 64>
+class ShardedMap {
+ public:
+  /**
+   * Returns the value or Value() if there is none.
+   */
+  Value find(const Key& key) const {
+    const auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    auto it = s.map_.find(key);
+    return it != s.map_.end() ? it->second : Value();
+  }
+
+  void set(const Key& key, Value value) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    s.map_[key] = std::move(value);
+  }
+
+  /**
+   * Returns the removed value or Value() if there was none.
+   */
+  Value erase(const Key& key) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    auto it = s.map_.find(key);
+    if (it == s.map_.end()) return Value();
+    auto value = std::move(it->second);
+    s.map_.erase(it);
+    return value;
+  }
+
+  /**
+   * Removes the value only if it's still the expected one.
+   */
+  void erase(const Key& key, const Value& expected) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    auto it = s.map_.find(key);
+    if (it != s.map_.end() && it->second == expected) s.map_.erase(it);
+  }
+
+  /**
+   * Returns the value, which factory creates first if there is none.
+   */
+  template <class Factory>
+  Value find_or_insert(const Key& key, Factory factory) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    auto it = s.map_.find(key);
+    if (it != s.map_.end()) return it->second;
+    return s.map_[key] = factory();
+  }
+
+  std::vector<Value> values() const {
+    std::vector<Value> result;
+    for (const auto& s : shard_) {
+      std::lock_guard<std::mutex> lock(s.mutex_);
+      for (const auto& d : s.map_) result.push_back(d.second);
+    }
+    return result;
+  }
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, Value> map_;
+  };
+
+  Shard& shard(const Key& key) {
+    return shard_[std::hash<Key>()(key) % ShardCount];
+  }
+
+  const Shard& shard(const Key& key) const {
+    return shard_[std::hash<Key>()(key) % ShardCount];
+  }
+
+  std::array<Shard, ShardCount> shard_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // SHARDED_MAP_H
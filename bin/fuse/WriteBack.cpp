@@ -0,0 +1,185 @@
+#include "WriteBack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "IHttp.h"
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+
+WriteBack::WriteBack(uint64_t window, std::string filename)
+    : window_(window),
+      filename_(std::move(filename)),
+      released_data_lost_(),
+      base_(),
+      sent_(),
+      size_(IItem::UnknownSize),
+      done_(),
+      aborted_() {}
+
+WriteBack::~WriteBack() {
+  if (released_data_) {
+    released_data_ = nullptr;
+    (void)std::remove(filename_.c_str());
+  }
+}
+
+bool WriteBack::write(const char* data, uint32_t size, uint64_t offset,
+                      const WriteCallback& callback) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Data the upload already read can't be changed anymore.
+  if (done_ || aborted_ || size_ != IItem::UnknownSize ||
+      offset < std::max(base_, sent_) || offset > written() + window_)
+    return false;
+  auto end = offset + size;
+  if (end - base_ > buffer_.size()) buffer_.resize(end - base_);
+  memcpy(&buffer_[offset - base_], data, size);
+  auto it = written_.upper_bound(offset);
+  if (it != written_.begin() && std::prev(it)->second >= offset) {
+    it = std::prev(it);
+    offset = it->first;
+  }
+  while (it != written_.end() && it->first <= end) {
+    end = std::max(end, it->second);
+    it = written_.erase(it);
+  }
+  written_[offset] = end;
+  pending_write_.push_back({size, callback});
+  notify(lock);
+  return true;
+}
+
+void WriteBack::finish(const DoneCallback& callback) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (done_) {
+    auto result = result_;
+    lock.unlock();
+    return callback(result);
+  }
+  finished_.push_back(callback);
+  if (size_ == IItem::UnknownSize) size_ = base_ + buffer_.size();
+  notify(lock);
+}
+
+void WriteBack::abort() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  aborted_ = true;
+  notify(lock);
+}
+
+std::unique_ptr<std::fstream> WriteBack::store() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  aborted_ = true;
+  notify(lock);
+  if (released_data_lost_) return nullptr;
+  auto store = std::move(released_data_);
+  if (!store)
+    store = util::make_unique<std::fstream>(
+        filename_,
+        std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  store->seekp(static_cast<std::streamoff>(base_));
+  store->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  store->flush();
+  if (!*store) {
+    store = nullptr;
+    (void)std::remove(filename_.c_str());
+  }
+  return store;
+}
+
+void WriteBack::waitForData(uint64_t offset, uint64_t length,
+                            std::function<void(EitherError<void>)> ready) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  wait_.push_back({offset + length, std::move(ready)});
+  notify(lock);
+}
+
+void WriteBack::releaseData(uint64_t offset, uint64_t length) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The buffer is kept whole for store().
+  if (aborted_) return;
+  released_[offset] = offset + length;
+  while (!released_.empty() && released_.begin()->first <= base_) {
+    auto end = released_.begin()->second;
+    if (end > base_) {
+      auto size = std::min<uint64_t>(end - base_, buffer_.size());
+      if (!released_data_ && !released_data_lost_)
+        released_data_ = util::make_unique<std::fstream>(
+            filename_,
+            std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!released_data_lost_) {
+        released_data_->seekp(static_cast<std::streamoff>(base_));
+        released_data_->write(buffer_.data(),
+                              static_cast<std::streamsize>(size));
+        released_data_lost_ = !*released_data_;
+      }
+      buffer_.erase(0, size);
+      base_ = end;
+    }
+    released_.erase(released_.begin());
+  }
+  notify(lock);
+}
+
+uint32_t WriteBack::putData(char* data, uint32_t maxlength, uint64_t offset) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (offset < base_ || offset - base_ >= buffer_.size()) return 0;
+  auto size = static_cast<uint32_t>(
+      std::min<uint64_t>(maxlength, buffer_.size() - (offset - base_)));
+  memcpy(data, &buffer_[offset - base_], size);
+  sent_ = std::max(sent_, offset + size);
+  return size;
+}
+
+uint64_t WriteBack::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void WriteBack::done(EitherError<IItem> e) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_ = true;
+  result_ = e;
+  auto finished = std::move(finished_);
+  finished_.clear();
+  notify(lock);
+  lock.unlock();
+  for (const auto& callback : finished) callback(e);
+}
+
+uint64_t WriteBack::written() const {
+  auto it = written_.begin();
+  return it != written_.end() && it->first == 0 ? it->second : 0;
+}
+
+void WriteBack::notify(std::unique_lock<std::mutex>& lock) {
+  std::vector<std::function<void(EitherError<void>)>> ready;
+  for (auto it = wait_.begin(); it != wait_.end();)
+    if (aborted_ || size_ != IItem::UnknownSize || it->end_ <= written()) {
+      // The upload may read the data as soon as it's told it's ready.
+      if (!aborted_) sent_ = std::max(sent_, it->end_);
+      ready.push_back(std::move(it->ready_));
+      it = wait_.erase(it);
+    } else {
+      ++it;
+    }
+  // Writes are held back only while the upload doesn't wait for them.
+  std::vector<std::pair<uint32_t, WriteCallback>> write;
+  if (done_ || aborted_ || !wait_.empty() || written() - base_ <= window_) {
+    write = std::move(pending_write_);
+    pending_write_.clear();
+  }
+  auto aborted = aborted_;
+  lock.unlock();
+  for (const auto& r : ready)
+    if (aborted)
+      r(Error{IHttpRequest::Aborted, util::Error::ABORTED});
+    else
+      r(nullptr);
+  for (const auto& w : write) w.second(w.first);
+  lock.lock();
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,94 @@
+#ifndef WRITE_BACK_H
+#define WRITE_BACK_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "IRequest.h"
+
+namespace cloudstorage {
+
+// Keeps data written to a new file until a streamed upload sends it, so
+// that the file doesn't have to be stored locally. Writes may come slightly
+// out of order; once more than window bytes wait for the upload, writes are
+// acknowledged only after sent parts are released, unless the upload waits
+// for more data. Data the upload released is kept in a temporary file, so
+// that a file written randomly after all can still be stored whole.
+class WriteBack : public IUploadStreamCallback {
+ public:
+  using Pointer = std::shared_ptr<WriteBack>;
+  using WriteCallback = std::function<void(EitherError<uint32_t>)>;
+  using DoneCallback = std::function<void(EitherError<IItem>)>;
+
+  WriteBack(uint64_t window, std::string filename);
+  ~WriteBack() override;
+
+  /**
+   * Returns false if the data can't be streamed, because it overlaps data
+   * which the upload already read, is too far ahead or the upload is over.
+   */
+  bool write(const char* data, uint32_t size, uint64_t offset,
+             const WriteCallback&);
+
+  /**
+   * Ends the file where the written data ends; callback is called once the
+   * upload is done.
+   */
+  void finish(const DoneCallback&);
+
+  /**
+   * Makes the upload fail; later writes aren't accepted.
+   */
+  void abort();
+
+  /**
+   * Aborts the upload and returns the temporary file with everything written
+   * so far, or null if released data couldn't be kept.
+   */
+  std::unique_ptr<std::fstream> store();
+
+  void waitForData(uint64_t offset, uint64_t length,
+                   std::function<void(EitherError<void>)> ready) override;
+  void releaseData(uint64_t offset, uint64_t length) override;
+  uint32_t putData(char* data, uint32_t maxlength, uint64_t offset) override;
+  uint64_t size() override;
+  void progress(uint64_t, uint64_t) override {}
+  void done(EitherError<IItem>) override;
+
+ private:
+  struct Wait {
+    uint64_t end_;
+    std::function<void(EitherError<void>)> ready_;
+  };
+
+  uint64_t written() const;
+  void notify(std::unique_lock<std::mutex>&);
+
+  std::mutex mutex_;
+  uint64_t window_;
+  std::string filename_;
+  std::unique_ptr<std::fstream> released_data_;
+  bool released_data_lost_;
+  uint64_t base_;
+  uint64_t sent_;
+  std::string buffer_;
+  std::map<uint64_t, uint64_t> written_;
+  std::map<uint64_t, uint64_t> released_;
+  uint64_t size_;
+  bool done_;
+  bool aborted_;
+  EitherError<IItem> result_;
+  std::vector<Wait> wait_;
+  std::vector<std::pair<uint32_t, WriteCallback>> pending_write_;
+  std::vector<DoneCallback> finished_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // WRITE_BACK_H
@@ -27,9 +27,21 @@
 #include <tinyxml2.h>
 #include <algorithm>
 #include <iomanip>
+#include <map>
+#include <unordered_map>
 
-#include "Request/RecursiveRequest.h"
+#include "Request/UploadFileRequest.h"
 #include "Utility/Utility.h"
+#include "Utility/XmlStreamParser.h"
+
+// DeleteObjects accepts at most 1000 keys.
+const size_t MAX_DELETE_KEYS = 1000;
+
+// S3 accepts parts between 5 MiB and 5 GiB, at most 10000 of them.
+const uint64_t DEFAULT_PART_SIZE = 8 * 1024 * 1024;
+const uint64_t MIN_PART_SIZE = 5 * 1024 * 1024;
+const uint64_t MAX_PART_SIZE = 5ull * 1024 * 1024 * 1024;
+const uint64_t MAX_PART_COUNT = 10000;
 
 using namespace std::placeholders;
 
@@ -52,16 +64,43 @@ std::string escapePath(const std::string& str) {
   return result;
 }
 
-std::string currentDate() {
-  auto time =
-      util::gmtime(std::chrono::duration_cast<std::chrono::seconds>(
-                       std::chrono::system_clock::now().time_since_epoch())
-                       .count());
-  std::stringstream ss;
-  ss << std::put_time(&time, "%Y%m%d");
-  return ss.str();
+std::string escapeXml(const std::string& str) {
+  std::string result;
+  for (char c : str)
+    switch (c) {
+      case '&':
+        result += "&amp;";
+        break;
+      case '<':
+        result += "&lt;";
+        break;
+      case '>':
+        result += "&gt;";
+        break;
+      case '"':
+        result += "&quot;";
+        break;
+      case '\'':
+        result += "&apos;";
+        break;
+      default:
+        result += c;
+    }
+  return result;
 }
 
+// FNV-1a of a part's data, saved with its etag to tell whether the part
+// still holds the same data when the upload is resumed.
+uint64_t partChecksum(uint64_t checksum, const char* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    checksum ^= static_cast<unsigned char>(data[i]);
+    checksum *= 1099511628211ull;
+  }
+  return checksum;
+}
+
+const uint64_t PART_CHECKSUM_INIT = 14695981039346656037ull;
+
 std::string currentDateAndTime() {
   auto time =
       util::gmtime(std::chrono::duration_cast<std::chrono::seconds>(
@@ -74,6 +113,50 @@ std::string currentDateAndTime() {
 
 }  // namespace
 
+struct AmazonS3::MultipartUpload {
+  IUploadFileCallback* callback_;
+  // Set if the size is unknown until the callback reports it.
+  IUploadStreamCallback* stream_ = nullptr;
+  IItem::Pointer parent_;
+  std::string filename_;
+  std::string key_;
+  std::string upload_id_;
+  uint64_t size_;
+  uint64_t part_size_;
+  uint32_t part_count_;
+  uint32_t concurrency_;
+  std::mutex mutex_;
+  uint32_t next_ = 1;
+  uint64_t uploaded_ = 0;
+  uint32_t running_ = 0;
+  uint32_t ready_ = 0;
+  bool waiting_ = false;
+  bool failed_ = false;
+  bool completing_ = false;
+  std::map<uint32_t, std::string> etags_;
+  std::map<uint32_t, uint64_t> checksums_;
+  // Parts of a resumed upload, reused only if their data didn't change.
+  std::map<uint32_t, std::pair<std::string, uint64_t>> saved_;
+  std::unordered_map<uint32_t, uint64_t> progress_;
+
+  uint64_t offset(uint32_t part) const { return (part - 1) * part_size_; }
+  uint64_t length(uint32_t part) const {
+    return std::min(part_size_, size_ - offset(part));
+  }
+};
+
+struct AmazonS3::SubtreeCopy {
+  Keys keys_;
+  std::function<std::string(const std::string&)> destination_;
+  KeysCompleted complete_;
+  uint32_t concurrency_;
+  std::mutex mutex_;
+  size_t next_ = 0;
+  uint32_t running_ = 0;
+  bool failed_ = false;
+  bool done_ = false;
+};
+
 AmazonS3::AmazonS3() : CloudProvider(util::make_unique<Auth>()) {}
 
 void AmazonS3::initialize(InitData&& init_data) {
@@ -87,6 +170,15 @@ void AmazonS3::initialize(InitData&& init_data) {
     setWithHint(init_data.hints_, "region",
                 [&](const std::string& v) { region_ = v; });
   }
+  setWithHint(init_data.hints_, "multipart_uploads",
+              [&](const std::string& v) {
+                std::unique_lock<std::mutex> lock(multipart_mutex_);
+                try {
+                  auto json = util::json::from_string(v);
+                  if (json.isObject()) multipart_uploads_ = json;
+                } catch (const Json::Exception&) {
+                }
+              });
   CloudProvider::initialize(std::move(init_data));
 }
 
@@ -120,6 +212,10 @@ ICloudProvider::Hints AmazonS3::hints() const {
   auto lock = auth_lock();
   hints.insert(
       {{"rewritten_endpoint", rewritten_endpoint_}, {"region", region_}});
+  std::unique_lock<std::mutex> multipart_lock(multipart_mutex_);
+  if (!multipart_uploads_.empty())
+    hints.insert(
+        {"multipart_uploads", util::json::to_string(multipart_uploads_)});
   return hints;
 }
 
@@ -174,75 +270,83 @@ AuthorizeRequest::Pointer AmazonS3::authorizeAsync() {
 ICloudProvider::MoveItemRequest::Pointer AmazonS3::moveItemAsync(
     IItem::Pointer source, IItem::Pointer destination,
     MoveItemCallback callback) {
-  using Request = RecursiveRequest<EitherError<IItem>>;
-  auto visitor = [=, this](Request::Pointer r, IItem::Pointer item,
-                           Request::CompleteCallback callback) {
-    auto l = getPath("/" + source->id()).length();
-    std::string new_path = destination->id() + item->id().substr(l);
-    r->request(
-        [=, this](util::Output) {
-          auto request = http()->create(endpoint() + "/" + new_path, "PUT");
-          if (item->type() != IItem::FileType::Directory)
-            request->setHeaderParameter(
-                "x-amz-copy-source", bucket() + "/" + escapePath(item->id()));
-          return request;
-        },
-        [=, this](EitherError<Response> e) {
-          if (e.left()) return callback(e.left());
-          r->request(
-              [=, this](util::Output) {
-                return http()->create(endpoint() + "/" + escapePath(item->id()),
-                                      "DELETE");
-              },
-              [=](EitherError<Response> e) {
-                if (e.left()) return callback(e.left());
-                IItem::Pointer renamed = std::make_shared<Item>(
-                    getFilename(new_path), new_path, item->size(),
-                    item->timestamp(), item->type());
-                callback(renamed);
-              });
-        });
-  };
-  return std::make_shared<Request>(shared_from_this(), source, callback,
-                                   visitor)
-      ->run();
+  auto l = getPath("/" + source->id()).length();
+  auto prefix = destination->id();
+  return moveSubtree(
+      source, [=](const std::string& key) { return prefix + key.substr(l); },
+      callback);
 }
 
 ICloudProvider::RenameItemRequest::Pointer AmazonS3::renameItemAsync(
     IItem::Pointer root, const std::string& name, RenameItemCallback callback) {
-  using Request = RecursiveRequest<EitherError<IItem>>;
   auto new_prefix = (getPath("/" + root->id()) + "/" + name).substr(1);
-  auto visitor = [=, this](Request::Pointer r, IItem::Pointer item,
-                           Request::CompleteCallback callback) {
-    auto new_path = new_prefix + "/" + item->id().substr(root->id().length());
-    if (!new_path.empty() && new_path.back() == '/' &&
-        item->type() != IItem::FileType::Directory)
-      new_path.pop_back();
-    r->request(
-        [=, this](util::Output) {
-          auto request = http()->create(endpoint() + "/" + new_path, "PUT");
-          if (item->type() != IItem::FileType::Directory)
-            request->setHeaderParameter(
-                "x-amz-copy-source", bucket() + "/" + escapePath(item->id()));
-          return request;
-        },
-        [=, this](EitherError<Response> e) {
-          if (e.left()) return callback(e.left());
-          r->request(
-              [=, this](util::Output) {
-                return http()->create(endpoint() + "/" + escapePath(item->id()),
-                                      "DELETE");
-              },
-              [=](EitherError<Response> e) {
-                if (e.left()) return callback(e.left());
-                IItem::Pointer renamed = std::make_shared<Item>(
-                    getFilename(new_path), new_path, item->size(),
-                    item->timestamp(), item->type());
-                callback(renamed);
-              });
-        });
-  };
-  return std::make_shared<Request>(shared_from_this(), root, callback, visitor)
+  auto directory = root->type() == IItem::FileType::Directory;
+  auto l = root->id().length();
+  return moveSubtree(
+      root,
+      [=](const std::string& key) {
+        auto new_path = new_prefix + "/" + key.substr(l);
+        if (!directory && new_path.back() == '/') new_path.pop_back();
+        return new_path;
+      },
+      callback);
+}
+
+ICloudProvider::UploadFileRequest::Pointer AmazonS3::uploadFileAsync(
+    IItem::Pointer parent, const std::string& filename,
+    IUploadFileCallback::Pointer cb) {
+  auto size = cb->size();
+  auto part_size = std::min(
+      std::max(upload_chunk_size(DEFAULT_PART_SIZE), MIN_PART_SIZE),
+      MAX_PART_SIZE);
+  auto upload = std::make_shared<MultipartUpload>();
+  upload->callback_ = cb.get();
+  upload->parent_ = parent;
+  upload->filename_ = filename;
+  upload->key_ = parent->id() + filename;
+  upload->size_ = size;
+  upload->part_size_ =
+      std::max(part_size, (size + MAX_PART_COUNT - 1) / MAX_PART_COUNT);
+  upload->concurrency_ = upload_concurrency();
+  {
+    std::unique_lock<std::mutex> lock(multipart_mutex_);
+    try {
+      const auto& saved = multipart_uploads_[upload->key_];
+      auto saved_part_size = saved["part_size"].asUInt64();
+      if (saved["upload_id"].asString().empty() ||
+          saved["size"].asUInt64() != size ||
+          saved_part_size < MIN_PART_SIZE ||
+          saved_part_size * MAX_PART_COUNT < size)
+        throw std::logic_error(util::Error::INVALID_STATE);
+      for (const auto& part : saved["parts"].getMemberNames()) {
+        auto number = std::stoul(part);
+        if (number < 1 || (number - 1) * saved_part_size >= size)
+          throw std::logic_error(util::Error::INVALID_STATE);
+        const auto& saved_part = saved["parts"][part];
+        if (saved_part.isObject())
+          upload->saved_[number] = {
+              saved_part["etag"].asString(),
+              std::stoull(saved_part["checksum"].asString())};
+      }
+      upload->upload_id_ = saved["upload_id"].asString();
+      upload->part_size_ = saved_part_size;
+    } catch (const std::exception&) {
+      upload->saved_.clear();
+      multipart_uploads_.removeMember(upload->key_);
+    }
+  }
+  if (upload->upload_id_.empty() && size <= part_size)
+    return CloudProvider::uploadFileAsync(parent, filename, cb);
+  upload->part_count_ = static_cast<uint32_t>(
+      (size + upload->part_size_ - 1) / upload->part_size_);
+  return std::make_shared<UploadRequest>(
+             shared_from_this(), [=](EitherError<IItem> e) { cb->done(e); },
+             [=, this](UploadRequest::Pointer r) {
+               if (upload->upload_id_.empty())
+                 createMultipartUpload(r, upload);
+               else
+                 scheduleParts(r, upload);
+             })
       ->run();
 }
 
@@ -263,22 +367,29 @@ IItem::Pointer AmazonS3::createDirectoryResponse(const IItem& parent,
 
 ICloudProvider::DeleteItemRequest::Pointer AmazonS3::deleteItemAsync(
     IItem::Pointer item, DeleteItemCallback callback) {
-  using Request = RecursiveRequest<EitherError<void>>;
-  auto visitor = [=, this](Request::Pointer r, IItem::Pointer item,
-                           Request::CompleteCallback complete) {
-    r->request(
-        [=, this](util::Output) {
-          return http()->create(endpoint() + "/" + escapePath(item->id()),
-                                "DELETE");
-        },
-        [=](EitherError<Response> e) {
-          if (e.left())
-            complete(e.left());
-          else
-            complete(nullptr);
-        });
-  };
-  return std::make_shared<Request>(shared_from_this(), item, callback, visitor)
+  using DeleteRequest = Request<EitherError<void>>;
+  return std::make_shared<DeleteRequest>(
+             shared_from_this(), callback,
+             [=, this](DeleteRequest::Pointer r) {
+               if (item->type() != IItem::FileType::Directory)
+                 return r->request(
+                     [=, this](util::Output) {
+                       return http()->create(
+                           endpoint() + "/" + escapePath(item->id()),
+                           "DELETE");
+                     },
+                     [=](EitherError<Response> e) {
+                       if (e.left()) return r->done(e.left());
+                       r->done(nullptr);
+                     });
+               auto keys = std::make_shared<std::vector<std::string>>();
+               listKeys(r, item->id(), "", keys,
+                        [=, this](EitherError<void> e) {
+                          if (e.left()) return r->done(e);
+                          deleteKeys(r, keys, 0,
+                                     [=](EitherError<void> e) { r->done(e); });
+                        });
+             })
       ->run();
 }
 
@@ -316,10 +427,9 @@ ICloudProvider::GetItemDataRequest::Pointer AmazonS3::getItemDataAsync(
                };
                r->request(factory, [=, this](EitherError<Response> e) {
                  if (e.left()) return r->done(e.left());
-                 std::stringstream sstream;
-                 sstream << e.right()->output().rdbuf();
+                 auto content = e.right()->output().view();
                  tinyxml2::XMLDocument document;
-                 if (document.Parse(sstream.str().c_str()) !=
+                 if (document.Parse(content.data(), content.size()) !=
                      tinyxml2::XML_SUCCESS)
                    return r->done(Error{IHttpRequest::Failure,
                                         util::Error::FAILED_TO_PARSE_XML});
@@ -385,63 +495,119 @@ IHttpRequest::Pointer AmazonS3::downloadFileRequest(const IItem& item,
   return http()->create(endpoint() + "/" + escapePath(item.id()), "GET");
 }
 
-IItem::List AmazonS3::listDirectoryResponse(
-    const IItem& parent, std::istream& stream,
-    std::string& next_page_token) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str()) != tinyxml2::XML_SUCCESS)
-    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
-  IItem::List result;
-  if (document.RootElement()->FirstChildElement("Name")) {
-    for (auto child = document.RootElement()->FirstChildElement("Contents");
-         child; child = child->NextSiblingElement("Contents")) {
-      auto size_element = child->FirstChildElement("Size");
-      if (!size_element) throw std::logic_error(util::Error::INVALID_XML);
-      auto size = std::stoull(size_element->GetText());
-      auto key_element = child->FirstChildElement("Key");
-      if (!key_element) throw std::logic_error(util::Error::INVALID_XML);
-      std::string id = key_element->GetText();
-      if (size == 0 && id == parent.id()) continue;
-      auto timestamp_element = child->FirstChildElement("LastModified");
-      if (!timestamp_element) throw std::logic_error(util::Error::INVALID_XML);
-      std::string timestamp = timestamp_element->GetText();
-      auto item = util::make_unique<Item>(getFilename(id), id, size,
-                                          util::parse_time(timestamp),
-                                          IItem::FileType::Unknown);
-      item->set_url(getUrl(*item));
-      result.push_back(std::move(item));
-    }
-    for (auto child =
-             document.RootElement()->FirstChildElement("CommonPrefixes");
-         child; child = child->NextSiblingElement("CommonPrefixes")) {
-      auto prefix_element = child->FirstChildElement("Prefix");
-      if (!prefix_element) throw std::logic_error(util::Error::INVALID_XML);
-      std::string id = prefix_element->GetText();
-      auto item = util::make_unique<Item>(
-          getFilename(id), id, IItem::UnknownSize, IItem::UnknownTimeStamp,
-          IItem::FileType::Directory);
-      result.push_back(std::move(item));
+// Builds items of a ListObjectsV2 page as its Contents and CommonPrefixes
+// are received.
+class AmazonS3::ListObjectsStream : public ListDirectoryStream {
+ public:
+  using Path = util::XmlStreamParser::Path;
+
+  ListObjectsStream(const AmazonS3* provider, const std::string& parent,
+                    const ReceivedItemCallback& received)
+      : ListDirectoryStream(nullptr),
+        provider_(provider),
+        parent_(parent),
+        received_(received),
+        parser_([this](const Path& path) { start(path); },
+                [this](const Path& path, const std::string& text) {
+                  end(path, text);
+                }),
+        listing_(),
+        truncated_() {
+    init(&parser_);
+  }
+
+  IItem::List finish(std::string& next_page_token) override {
+    parser_.finish();
+    if (!listing_) return {};
+    if (!truncated_) throw std::logic_error(util::Error::INVALID_XML);
+    if (*truncated_ == "true") {
+      if (!next_token_) throw std::logic_error(util::Error::INVALID_XML);
+      next_page_token = *next_token_;
     }
-    auto is_truncated_element =
-        document.RootElement()->FirstChildElement("IsTruncated");
-    if (!is_truncated_element) throw std::logic_error(util::Error::INVALID_XML);
-    if (is_truncated_element->GetText() == std::string("true")) {
-      auto next_token_element =
-          document.RootElement()->FirstChildElement("NextContinuationToken");
-      if (!next_token_element) throw std::logic_error(util::Error::INVALID_XML);
-      next_page_token = next_token_element->GetText();
+    return std::move(items_);
+  }
+
+ private:
+  void start(const Path& path) {
+    if (path.size() == 2) fields_.clear();
+  }
+
+  void end(const Path& path, const std::string& text) {
+    if (path.size() == 3) {
+      fields_[path[2]] = text;
+    } else if (path.size() == 2) {
+      if (path[1] == "Name") {
+        // Only ListBucketResult has Name, which S3 sends first.
+        listing_ = true;
+        if (received_)
+          for (const auto& item : items_) received_(item);
+      } else if (path[1] == "Contents") {
+        auto size = std::stoull(field("Size"));
+        auto id = field("Key");
+        if (size == 0 && id == parent_) return;
+        auto item = std::make_shared<Item>(
+            getFilename(id), id, size, util::parse_time(field("LastModified")),
+            IItem::FileType::Unknown);
+        item->set_url(provider_->getUrl(*item));
+        add(item);
+      } else if (path[1] == "CommonPrefixes") {
+        auto id = field("Prefix");
+        add(std::make_shared<Item>(getFilename(id), id, IItem::UnknownSize,
+                                   IItem::UnknownTimeStamp,
+                                   IItem::FileType::Directory));
+      } else if (path[1] == "IsTruncated") {
+        truncated_ = std::make_unique<std::string>(text);
+      } else if (path[1] == "NextContinuationToken") {
+        next_token_ = std::make_unique<std::string>(text);
+      }
     }
   }
-  return result;
+
+  const std::string& field(const std::string& name) const {
+    auto it = fields_.find(name);
+    if (it == fields_.end()) throw std::logic_error(util::Error::INVALID_XML);
+    return it->second;
+  }
+
+  void add(IItem::Pointer item) {
+    items_.push_back(item);
+    if (listing_ && received_) received_(item);
+  }
+
+  const AmazonS3* provider_;
+  std::string parent_;
+  ReceivedItemCallback received_;
+  util::XmlStreamParser parser_;
+  std::unordered_map<std::string, std::string> fields_;
+  IItem::List items_;
+  bool listing_;
+  std::unique_ptr<std::string> truncated_;
+  std::unique_ptr<std::string> next_token_;
+};
+
+IItem::List AmazonS3::listDirectoryResponse(
+    const IItem& parent, std::istream& stream,
+    std::string& next_page_token) const {
+  std::string storage;
+  auto content = util::view(stream, storage);
+  ListObjectsStream list(this, parent.id(), nullptr);
+  list.write(content.data(), static_cast<std::streamsize>(content.size()));
+  return list.finish(next_page_token);
+}
+
+std::shared_ptr<CloudProvider::ListDirectoryStream>
+AmazonS3::listDirectoryStream(const IItem& parent,
+                              const ReceivedItemCallback& received) const {
+  return std::make_shared<ListObjectsStream>(this, parent.id(), received);
 }
 
+bool AmazonS3::supportsListDirectoryStream() const { return true; }
+
 void AmazonS3::authorizeRequest(IHttpRequest& request) const {
   if (!crypto()) throw std::runtime_error("no crypto functions provided");
   std::string region = this->region().empty() ? "us-east-1" : this->region();
-  std::string current_date = currentDate();
   std::string time = currentDateAndTime();
+  std::string current_date = time.substr(0, time.find('T'));
   std::string scope = current_date + "/" + region + "/s3/aws4_request";
   util::Url url(request.url());
   request.setParameter("X-Amz-Algorithm", "AWS4-HMAC-SHA256");
@@ -450,64 +616,69 @@ void AmazonS3::authorizeRequest(IHttpRequest& request) const {
   request.setParameter("X-Amz-Expires", "86400");
   request.setHeaderParameter("host", url.host());
 
-  std::vector<std::pair<std::string, std::string>> header_parameters;
-  for (auto q : request.headerParameters())
-    header_parameters.emplace_back(util::to_lower(q.first), q.second);
-  std::sort(header_parameters.begin(), header_parameters.end());
+  std::vector<std::pair<std::string, const std::string*>> header_parameters;
+  header_parameters.reserve(request.headerParameters().size());
+  for (const auto& q : request.headerParameters())
+    header_parameters.emplace_back(util::to_lower(q.first), &q.second);
+  std::sort(header_parameters.begin(), header_parameters.end(),
+            [](const auto& a, const auto& b) {
+              return a.first != b.first ? a.first < b.first
+                                        : *a.second < *b.second;
+            });
 
   std::string signed_headers;
-  {
-    bool first = false;
-    for (const auto& q : header_parameters) {
-      if (first)
-        signed_headers += ";";
-      else
-        first = true;
-      signed_headers += q.first;
-    }
-    request.setParameter("X-Amz-SignedHeaders", signed_headers);
+  std::string canonical_headers;
+  for (const auto& q : header_parameters) {
+    if (!signed_headers.empty()) signed_headers += ";";
+    signed_headers += q.first;
+    canonical_headers += util::Url::escape(q.first) + ":" + *q.second + "\n";
   }
+  request.setParameter("X-Amz-SignedHeaders", signed_headers);
 
-  std::vector<std::pair<std::string, std::string>> query_parameters;
-  for (auto q : request.parameters())
-    query_parameters.emplace_back(q.first, q.second);
+  // Values are escaped once, for both the canonical request and the url.
+  std::vector<std::pair<std::string, std::string>> query_parameters(
+      request.parameters().begin(), request.parameters().end());
   std::sort(query_parameters.begin(), query_parameters.end());
 
   std::string canonical_request = request.method() + "\n" + url.path() + "\n";
-
-  bool first = false;
-  for (const auto& q : query_parameters) {
-    if (first)
-      canonical_request += "&";
-    else
-      first = true;
-    canonical_request +=
-        util::Url::escape(q.first) + "=" + util::Url::escape(q.second);
+  for (auto& q : query_parameters) {
+    q.second = util::Url::escape(q.second);
+    if (&q != &query_parameters.front()) canonical_request += "&";
+    canonical_request += util::Url::escape(q.first) + "=" + q.second;
   }
   canonical_request += "\n";
-
-  for (const auto& q : header_parameters)
-    canonical_request += util::Url::escape(q.first) + ":" + q.second + "\n";
+  canonical_request += canonical_headers;
   canonical_request += "\n";
   canonical_request += signed_headers + "\n";
   canonical_request += "UNSIGNED-PAYLOAD";
 
-  auto hash = std::bind(&ICrypto::sha256, crypto(), _1);
-  auto sign = std::bind(&ICrypto::hmac_sha256, crypto(), _1, _2);
-  auto hex = std::bind(&ICrypto::hex, crypto(), _1);
-
-  std::string string_to_sign = "AWS4-HMAC-SHA256\n" + time + "\n" + scope +
-                               "\n" + hex(hash(canonical_request));
-  std::string key =
-      sign(sign(sign(sign("AWS4" + secret(), current_date), region), "s3"),
-           "aws4_request");
-  std::string signature = hex(sign(key, string_to_sign));
+  std::string string_to_sign =
+      "AWS4-HMAC-SHA256\n" + time + "\n" + scope + "\n" +
+      crypto()->hex(crypto()->sha256(canonical_request));
+  std::string signature = crypto()->hex(crypto()->hmac_sha256(
+      signingKey(current_date, region), string_to_sign));
 
+  for (const auto& q : query_parameters) request.setParameter(q.first, q.second);
   request.setParameter("X-Amz-Signature", signature);
+}
 
-  auto params = request.parameters();
-  for (const auto& p : params)
-    request.setParameter(p.first, util::Url::escape(p.second));
+std::string AmazonS3::signingKey(const std::string& date,
+                                 const std::string& region) const {
+  auto secret = this->secret();
+  std::unique_lock<std::mutex> lock(signing_key_mutex_);
+  if (signing_key_date_ != date || signing_key_region_ != region ||
+      signing_key_secret_ != secret) {
+    auto sign = [this](const std::string& key, const std::string& message) {
+      return crypto()->hmac_sha256(key, message);
+    };
+    signing_key_ =
+        sign(sign(sign(sign("AWS4" + secret, date), region), "s3"),
+             "aws4_request");
+    signing_key_date_ = date;
+    signing_key_region_ = region;
+    signing_key_secret_ = secret;
+  }
+  return signing_key_;
 }
 
 bool AmazonS3::reauthorize(int code,
@@ -602,8 +773,9 @@ void AmazonS3::getRegion(const AuthorizeRequest::Pointer& r,
           }
           complete(e.left());
         } else {
+          auto content = e.right()->output().view();
           tinyxml2::XMLDocument document;
-          if (document.Parse(e.right()->output().str().c_str()) != 0)
+          if (document.Parse(content.data(), content.size()) != 0)
             return complete(
                 Error{IHttpRequest::Failure, util::Error::FAILED_TO_PARSE_XML});
           auto location = document.RootElement();
@@ -654,4 +826,508 @@ void AmazonS3::getEndpoint(
       });
 }
 
+ICloudProvider::UploadFileRequest::Pointer AmazonS3::uploadFileStreamAsync(
+    IItem::Pointer parent, const std::string& filename,
+    IUploadStreamCallback::Pointer cb) {
+  auto upload = std::make_shared<MultipartUpload>();
+  upload->callback_ = cb.get();
+  upload->stream_ = cb.get();
+  upload->parent_ = parent;
+  upload->filename_ = filename;
+  upload->key_ = parent->id() + filename;
+  upload->size_ = IItem::UnknownSize;
+  upload->part_size_ = std::min(
+      std::max(upload_chunk_size(DEFAULT_PART_SIZE), MIN_PART_SIZE),
+      MAX_PART_SIZE);
+  // One more part is awaited to find out the stream is too long.
+  upload->part_count_ = MAX_PART_COUNT + 1;
+  upload->concurrency_ = upload_concurrency();
+  return std::make_shared<UploadRequest>(
+             shared_from_this(), [=](EitherError<IItem> e) { cb->done(e); },
+             [=, this](UploadRequest::Pointer r) {
+               createMultipartUpload(r, upload);
+             })
+      ->run();
+}
+
+void AmazonS3::createMultipartUpload(const UploadRequest::Pointer& r,
+                                     const MultipartUploadPointer& upload) {
+  r->request(
+      [=, this](util::Output) {
+        auto request =
+            http()->create(endpoint() + "/" + escapePath(upload->key_), "POST");
+        request->setParameter("uploads", "");
+        return request;
+      },
+      [=, this](EitherError<Response> e) {
+        if (e.left()) return r->done(e.left());
+        auto content = e.right()->output().view();
+        tinyxml2::XMLDocument document;
+        if (document.Parse(content.data(), content.size()) !=
+            tinyxml2::XML_SUCCESS)
+          return r->done(
+              Error{IHttpRequest::Failure, util::Error::FAILED_TO_PARSE_XML});
+        auto root = document.RootElement();
+        auto upload_id = root ? root->FirstChildElement("UploadId") : nullptr;
+        if (!upload_id || !upload_id->GetText())
+          return r->done(
+              Error{IHttpRequest::Failure, util::Error::INVALID_XML});
+        upload->upload_id_ = upload_id->GetText();
+        // Streamed data can't be read again, so there is nothing to resume.
+        if (!upload->stream_) saveMultipartUpload(*upload);
+        scheduleParts(r, upload);
+      });
+}
+
+void AmazonS3::scheduleParts(const UploadRequest::Pointer& r,
+                             const MultipartUploadPointer& upload) {
+  std::unique_lock<std::mutex> lock(upload->mutex_);
+  while (!upload->failed_ && upload->running_ < upload->concurrency_ &&
+         upload->next_ <= upload->part_count_) {
+    if (upload->stream_ && upload->size_ == IItem::UnknownSize &&
+        upload->next_ > upload->ready_) {
+      if (upload->waiting_) return;
+      upload->waiting_ = true;
+      auto part = upload->next_;
+      lock.unlock();
+      return upload->stream_->waitForData(
+          upload->offset(part), upload->part_size_,
+          [=, this](EitherError<void> e) { streamedPart(r, upload, part, e); });
+    }
+    auto part = upload->next_++;
+    auto saved = upload->saved_.find(part);
+    if (saved != upload->saved_.end()) {
+      auto etag = saved->second.first;
+      auto saved_checksum = saved->second.second;
+      upload->saved_.erase(saved);
+      upload->running_++;
+      lock.unlock();
+      auto unchanged = checksum(*upload, part) == saved_checksum;
+      lock.lock();
+      upload->running_--;
+      if (unchanged) {
+        upload->etags_[part] = etag;
+        upload->checksums_[part] = saved_checksum;
+        upload->uploaded_ += upload->length(part);
+        continue;
+      }
+    }
+    upload->running_++;
+    lock.unlock();
+    uploadPart(r, upload, part);
+    lock.lock();
+  }
+  if (!upload->failed_ && !upload->completing_ && upload->running_ == 0 &&
+      upload->size_ != IItem::UnknownSize &&
+      upload->etags_.size() == upload->part_count_) {
+    upload->completing_ = true;
+    lock.unlock();
+    completeMultipartUpload(r, upload);
+  }
+}
+
+uint64_t AmazonS3::checksum(const MultipartUpload& upload, uint32_t part) {
+  std::vector<char> buffer(UploadChunkStreamWrapper::BUFFER_SIZE);
+  auto checksum = PART_CHECKSUM_INIT;
+  for (uint64_t read = 0; read < upload.length(part);) {
+    auto size = upload.callback_->putData(
+        buffer.data(),
+        static_cast<uint32_t>(std::min<uint64_t>(buffer.size(),
+                                                 upload.length(part) - read)),
+        upload.offset(part) + read);
+    if (size == 0) break;
+    checksum = partChecksum(checksum, buffer.data(), size);
+    read += size;
+  }
+  return checksum;
+}
+
+void AmazonS3::streamedPart(const UploadRequest::Pointer& r,
+                            const MultipartUploadPointer& upload,
+                            uint32_t part, EitherError<void> e) {
+  std::unique_lock<std::mutex> lock(upload->mutex_);
+  upload->waiting_ = false;
+  if (e.left()) {
+    if (upload->failed_) return;
+    upload->failed_ = true;
+    lock.unlock();
+    return failMultipartUpload(r, upload, *e.left());
+  }
+  auto size = upload->stream_->size();
+  if (size == IItem::UnknownSize) {
+    upload->ready_ = part;
+  } else {
+    upload->size_ = size;
+    upload->part_count_ = static_cast<uint32_t>(std::max<uint64_t>(
+        1, (size + upload->part_size_ - 1) / upload->part_size_));
+  }
+  if (!upload->failed_ &&
+      (upload->ready_ > MAX_PART_COUNT ||
+       (upload->size_ != IItem::UnknownSize &&
+        upload->part_count_ > MAX_PART_COUNT))) {
+    upload->failed_ = true;
+    lock.unlock();
+    return failMultipartUpload(
+        r, upload, Error{IHttpRequest::Bad, util::Error::FILE_TOO_BIG});
+  }
+  lock.unlock();
+  scheduleParts(r, upload);
+}
+
+void AmazonS3::uploadPart(const UploadRequest::Pointer& r,
+                          const MultipartUploadPointer& upload, uint32_t part) {
+  auto checksum = std::make_shared<uint64_t>(PART_CHECKSUM_INIT);
+  auto wrapper = std::make_shared<UploadChunkStreamWrapper>(
+      [=](char* data, uint32_t maxlength, uint64_t offset) {
+        auto size = upload->callback_->putData(data, maxlength, offset);
+        // The part is read again from its start when the request is retried.
+        if (offset == upload->offset(part)) *checksum = PART_CHECKSUM_INIT;
+        *checksum = partChecksum(*checksum, data, size);
+        return size;
+      },
+      upload->offset(part), upload->length(part));
+  r->send(
+      [=, this](util::Output) {
+        auto request =
+            http()->create(endpoint() + "/" + escapePath(upload->key_), "PUT");
+        request->setParameter("partNumber", std::to_string(part));
+        request->setParameter("uploadId", upload->upload_id_);
+        return request;
+      },
+      [=, this](EitherError<Response> e) {
+        std::unique_lock<std::mutex> lock(upload->mutex_);
+        upload->running_--;
+        upload->progress_.erase(part);
+        if (upload->failed_) return;
+        if (e.left()) {
+          upload->failed_ = true;
+          lock.unlock();
+          return failMultipartUpload(r, upload, *e.left());
+        }
+        auto etag = e.right()->headers().find("etag");
+        if (etag == e.right()->headers().end()) {
+          upload->failed_ = true;
+          lock.unlock();
+          return failMultipartUpload(
+              r, upload,
+              Error{IHttpRequest::Failure,
+                    util::Error::UNKNOWN_RESPONSE_RECEIVED});
+        }
+        auto length = upload->length(part);
+        upload->etags_[part] = etag->second;
+        upload->checksums_[part] = *checksum;
+        upload->uploaded_ += length;
+        saveMultipartUploadPart(*upload, part);
+        lock.unlock();
+        if (upload->stream_)
+          upload->stream_->releaseData(upload->offset(part), length);
+        scheduleParts(r, upload);
+      },
+      [=] {
+        wrapper->reset();
+        return std::make_shared<std::iostream>(wrapper.get());
+      },
+      std::make_shared<util::MemoryStream>(), nullptr,
+      [=](uint64_t, uint64_t now) {
+        std::unique_lock<std::mutex> lock(upload->mutex_);
+        upload->progress_[part] = now;
+        auto sent = upload->uploaded_;
+        for (const auto& p : upload->progress_) sent += p.second;
+        lock.unlock();
+        upload->callback_->progress(upload->size_, sent);
+      },
+      true);
+}
+
+void AmazonS3::completeMultipartUpload(const UploadRequest::Pointer& r,
+                                       const MultipartUploadPointer& upload) {
+  r->request(
+      [=, this](util::Output stream) {
+        auto request =
+            http()->create(endpoint() + "/" + escapePath(upload->key_), "POST");
+        request->setParameter("uploadId", upload->upload_id_);
+        *stream << "<CompleteMultipartUpload>";
+        for (const auto& part : upload->etags_)
+          *stream << "<Part><PartNumber>" << part.first << "</PartNumber><ETag>"
+                  << part.second << "</ETag></Part>";
+        *stream << "</CompleteMultipartUpload>";
+        return request;
+      },
+      [=, this](EitherError<Response> e) {
+        if (e.left()) return failMultipartUpload(r, upload, *e.left());
+        // Errors which happen after the response started are reported with
+        // code 200 and an Error document.
+        auto content = e.right()->output().view();
+        tinyxml2::XMLDocument document;
+        if (document.Parse(content.data(), content.size()) !=
+                tinyxml2::XML_SUCCESS ||
+            !document.RootElement() ||
+            document.RootElement()->Name() == std::string("Error"))
+          return failMultipartUpload(
+              r, upload,
+              Error{IHttpRequest::Failure, e.right()->output().str()});
+        removeMultipartUpload(*upload);
+        r->done(uploadFileResponse(*upload->parent_, upload->filename_,
+                                   upload->size_, e.right()->output()));
+      });
+}
+
+void AmazonS3::saveMultipartUpload(const MultipartUpload& upload) {
+  std::unique_lock<std::mutex> lock(multipart_mutex_);
+  Json::Value json;
+  json["upload_id"] = upload.upload_id_;
+  json["size"] = Json::UInt64(upload.size_);
+  json["part_size"] = Json::UInt64(upload.part_size_);
+  json["parts"] = Json::Value(Json::objectValue);
+  multipart_uploads_[upload.key_] = json;
+}
+
+void AmazonS3::saveMultipartUploadPart(const MultipartUpload& upload,
+                                       uint32_t part) {
+  std::unique_lock<std::mutex> lock(multipart_mutex_);
+  if (!multipart_uploads_.isMember(upload.key_)) return;
+  auto& json = multipart_uploads_[upload.key_];
+  if (json["upload_id"].asString() != upload.upload_id_) return;
+  Json::Value saved_part;
+  saved_part["etag"] = upload.etags_.at(part);
+  saved_part["checksum"] = std::to_string(upload.checksums_.at(part));
+  json["parts"][std::to_string(part)] = saved_part;
+}
+
+void AmazonS3::failMultipartUpload(const UploadRequest::Pointer& r,
+                                   const MultipartUploadPointer& upload,
+                                   const Error& e) {
+  // Upload id expired or got aborted, next attempt starts over. Streamed
+  // uploads can't be resumed, and neither can those the server rejected;
+  // their parts would be kept and billed until they're aborted.
+  auto rejected =
+      e.code_ == IHttpRequest::Failure ||
+      (e.code_ / 100 == 4 && e.code_ != IHttpRequest::Unauthorized &&
+       e.code_ != IHttpRequest::Forbidden);
+  if (e.code_ == IHttpRequest::NotFound) {
+    removeMultipartUpload(*upload);
+  } else if (upload->stream_ || rejected) {
+    removeMultipartUpload(*upload);
+    abortMultipartUpload(*upload);
+  }
+  r->done(e);
+}
+
+void AmazonS3::abortMultipartUpload(const MultipartUpload& upload) {
+  // Without an upload id the request would delete the object.
+  if (upload.upload_id_.empty()) return;
+  auto request =
+      http()->create(endpoint() + "/" + escapePath(upload.key_), "DELETE");
+  request->setParameter("uploadId", upload.upload_id_);
+  authorizeRequest(*request);
+  // Sent on its own, the upload request may be cancelled already; it's
+  // best effort, S3 lifecycle rules can clean up what's left.
+  request->send([](IHttpRequest::Response) {},
+                std::make_shared<std::stringstream>(),
+                std::make_shared<std::stringstream>(),
+                std::make_shared<std::stringstream>());
+}
+
+void AmazonS3::removeMultipartUpload(const MultipartUpload& upload) {
+  std::unique_lock<std::mutex> lock(multipart_mutex_);
+  if (multipart_uploads_.isMember(upload.key_) &&
+      multipart_uploads_[upload.key_]["upload_id"].asString() ==
+          upload.upload_id_)
+    multipart_uploads_.removeMember(upload.key_);
+}
+
+template <class T>
+void AmazonS3::listKeys(const std::shared_ptr<Request<T>>& r,
+                        const std::string& prefix,
+                        const std::string& page_token, const Keys& keys,
+                        const KeysCompleted& complete) {
+  r->request(
+      [=, this](util::Output) {
+        auto request = http()->create(endpoint() + "/", "GET");
+        request->setParameter("list-type", "2");
+        request->setParameter("prefix", prefix);
+        if (!page_token.empty())
+          request->setParameter("continuation-token", page_token);
+        return request;
+      },
+      [=, this](EitherError<Response> e) {
+        if (e.left()) return complete(e.left());
+        auto content = e.right()->output().view();
+        tinyxml2::XMLDocument document;
+        if (document.Parse(content.data(), content.size()) !=
+                tinyxml2::XML_SUCCESS ||
+            !document.RootElement())
+          return complete(
+              Error{IHttpRequest::Failure, util::Error::FAILED_TO_PARSE_XML});
+        auto root = document.RootElement();
+        for (auto child = root->FirstChildElement("Contents"); child;
+             child = child->NextSiblingElement("Contents")) {
+          auto key = child->FirstChildElement("Key");
+          if (!key || !key->GetText())
+            return complete(
+                Error{IHttpRequest::Failure, util::Error::INVALID_XML});
+          keys->push_back(key->GetText());
+        }
+        auto is_truncated = root->FirstChildElement("IsTruncated");
+        if (is_truncated && is_truncated->GetText() == std::string("true")) {
+          auto next_token = root->FirstChildElement("NextContinuationToken");
+          if (!next_token || !next_token->GetText())
+            return complete(
+                Error{IHttpRequest::Failure, util::Error::INVALID_XML});
+          return listKeys(r, prefix, next_token->GetText(), keys, complete);
+        }
+        complete(nullptr);
+      });
+}
+
+template <class T>
+void AmazonS3::deleteKeys(const std::shared_ptr<Request<T>>& r,
+                          const Keys& keys, size_t offset,
+                          const KeysCompleted& complete) {
+  if (offset >= keys->size()) return complete(nullptr);
+  auto end = std::min(offset + MAX_DELETE_KEYS, keys->size());
+  r->request(
+      [=, this](util::Output stream) {
+        std::string body = "<Delete><Quiet>true</Quiet>";
+        for (size_t i = offset; i < end; i++)
+          body += "<Object><Key>" + escapeXml((*keys)[i]) + "</Key></Object>";
+        body += "</Delete>";
+        auto request = http()->create(endpoint() + "/", "POST");
+        request->setParameter("delete", "");
+        // DeleteObjects requires a checksum of the body.
+        request->setHeaderParameter("x-amz-sdk-checksum-algorithm", "SHA256");
+        request->setHeaderParameter("x-amz-checksum-sha256",
+                                    util::to_base64(crypto()->sha256(body)));
+        *stream << body;
+        return request;
+      },
+      [=, this](EitherError<Response> e) {
+        if (e.left()) return complete(e.left());
+        auto content = e.right()->output().view();
+        tinyxml2::XMLDocument document;
+        if (document.Parse(content.data(), content.size()) !=
+                tinyxml2::XML_SUCCESS ||
+            !document.RootElement())
+          return complete(
+              Error{IHttpRequest::Failure, util::Error::FAILED_TO_PARSE_XML});
+        // In quiet mode only the keys which failed to be deleted are listed.
+        auto root = document.RootElement();
+        auto error = root->Name() == std::string("Error")
+                         ? root
+                         : root->FirstChildElement("Error");
+        if (error) {
+          auto message = error->FirstChildElement("Message");
+          return complete(Error{IHttpRequest::Failure,
+                                message && message->GetText()
+                                    ? message->GetText()
+                                    : e.right()->output().str()});
+        }
+        deleteKeys(r, keys, end, complete);
+      });
+}
+
+ICloudProvider::MoveItemRequest::Pointer AmazonS3::moveSubtree(
+    IItem::Pointer item,
+    std::function<std::string(const std::string&)> destination,
+    MoveItemCallback callback) {
+  return std::make_shared<MoveRequest>(
+             shared_from_this(), callback,
+             [=, this](MoveRequest::Pointer r) {
+               auto target = destination(item->id());
+               auto moved = [=](EitherError<void> e) {
+                 if (e.left()) return r->done(e.left());
+                 r->done(EitherError<IItem>(std::make_shared<Item>(
+                     getFilename(target), target, item->size(),
+                     item->timestamp(), item->type())));
+               };
+               auto keys = std::make_shared<std::vector<std::string>>();
+               if (item->type() != IItem::FileType::Directory)
+                 return copyKey(
+                     r, item->id(), target, [=, this](EitherError<void> e) {
+                       if (e.left()) return moved(e);
+                       r->request(
+                           [=, this](util::Output) {
+                             return http()->create(
+                                 endpoint() + "/" + escapePath(item->id()),
+                                 "DELETE");
+                           },
+                           [=](EitherError<Response> e) {
+                             if (e.left()) return moved(e.left());
+                             moved(nullptr);
+                           });
+                     });
+               listKeys(r, item->id(), "", keys,
+                        [=, this](EitherError<void> e) {
+                          if (e.left()) return moved(e);
+                          auto copy = std::make_shared<SubtreeCopy>();
+                          copy->keys_ = keys;
+                          copy->destination_ = destination;
+                          copy->concurrency_ = recursive_concurrency();
+                          copy->complete_ = [=, this](EitherError<void> e) {
+                            if (e.left()) return moved(e);
+                            deleteKeys(r, keys, 0, moved);
+                          };
+                          scheduleCopies(r, copy);
+                        });
+             })
+      ->run();
+}
+
+void AmazonS3::copyKey(const MoveRequest::Pointer& r, const std::string& key,
+                       const std::string& destination,
+                       const KeysCompleted& complete) {
+  r->request(
+      [=, this](util::Output) {
+        auto request =
+            http()->create(endpoint() + "/" + escapePath(destination), "PUT");
+        request->setHeaderParameter("x-amz-copy-source",
+                                    bucket() + "/" + escapePath(key));
+        return request;
+      },
+      [=](EitherError<Response> e) {
+        if (e.left()) return complete(e.left());
+        // Errors which happen after the response started are reported with
+        // code 200 and an Error document.
+        auto content = e.right()->output().view();
+        tinyxml2::XMLDocument document;
+        if (document.Parse(content.data(), content.size()) ==
+                tinyxml2::XML_SUCCESS &&
+            document.RootElement() &&
+            document.RootElement()->Name() == std::string("Error"))
+          return complete(
+              Error{IHttpRequest::Failure, e.right()->output().str()});
+        complete(nullptr);
+      });
+}
+
+void AmazonS3::scheduleCopies(const MoveRequest::Pointer& r,
+                              const SubtreeCopyPointer& copy) {
+  std::unique_lock<std::mutex> lock(copy->mutex_);
+  if (!copy->failed_ && !copy->done_ && copy->running_ == 0 &&
+      copy->next_ == copy->keys_->size()) {
+    copy->done_ = true;
+    lock.unlock();
+    return copy->complete_(nullptr);
+  }
+  while (!copy->failed_ && copy->running_ < copy->concurrency_ &&
+         copy->next_ < copy->keys_->size()) {
+    auto key = (*copy->keys_)[copy->next_++];
+    copy->running_++;
+    lock.unlock();
+    copyKey(r, key, copy->destination_(key), [=, this](EitherError<void> e) {
+      std::unique_lock<std::mutex> lock(copy->mutex_);
+      copy->running_--;
+      if (copy->failed_) return;
+      if (e.left()) {
+        copy->failed_ = true;
+        lock.unlock();
+        return copy->complete_(e);
+      }
+      lock.unlock();
+      scheduleCopies(r, copy);
+    });
+    lock.lock();
+  }
+}
+
 }  // namespace cloudstorage
@@ -24,6 +24,7 @@
 #ifndef AMAZONS3_H
 #define AMAZONS3_H
 
+#include <json/json.h>
 #include "CloudProvider.h"
 
 #include "Utility/Item.h"
@@ -32,11 +33,16 @@ namespace cloudstorage {
 
 /**
  * AmazonS3 requires computing HMAC-SHA256 hashes, so it requires a valid
- * ICrypto implementation. Be careful about renaming and moving directories,
- * because there has to be an http request per each of its subelement. Buckets
- * are listed as root directory's children, renaming and moving them doesn't
- * work. Token in this case is a base64 encoded json with fields
- * username (access_id), password (secret_key), region.
+ * ICrypto implementation. Renaming and moving a directory copies each of its
+ * objects, recursive_concurrency of them at once; deleting it removes up to
+ * 1000 objects per request. Buckets are listed as root directory's children,
+ * renaming and moving them doesn't work. Token in this case is a base64 encoded
+ * json with fields username (access_id), password (secret_key), region. Files
+ * bigger than upload_chunk_size (8 MiB by default) are sent with multipart
+ * upload; its progress is reported through hints() so that the upload can be
+ * resumed. Parts are reused only if a checksum of their data didn't change.
+ * Files of unknown size are streamed with multipart upload too, up to 10000
+ * parts. Multipart uploads which can't be resumed are aborted.
  */
 class AmazonS3 : public CloudProvider {
  public:
@@ -61,6 +67,12 @@ class AmazonS3 : public CloudProvider {
                                              RenameItemCallback) override;
   DeleteItemRequest::Pointer deleteItemAsync(IItem::Pointer,
                                              DeleteItemCallback) override;
+  UploadFileRequest::Pointer uploadFileAsync(
+      IItem::Pointer, const std::string& filename,
+      IUploadFileCallback::Pointer) override;
+  UploadFileRequest::Pointer uploadFileStreamAsync(
+      IItem::Pointer, const std::string& filename,
+      IUploadStreamCallback::Pointer) override;
   GeneralDataRequest::Pointer getGeneralDataAsync(GeneralDataCallback) override;
 
   IHttpRequest::Pointer createDirectoryRequest(const IItem&,
@@ -77,6 +89,9 @@ class AmazonS3 : public CloudProvider {
 
   IItem::List listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  std::shared_ptr<ListDirectoryStream> listDirectoryStream(
+      const IItem&, const ReceivedItemCallback&) const override;
+  bool supportsListDirectoryStream() const override;
   IItem::Pointer createDirectoryResponse(const IItem& parent,
                                          const std::string& name,
                                          std::istream& response) const override;
@@ -98,17 +113,76 @@ class AmazonS3 : public CloudProvider {
  private:
   bool unpackCredentials(const std::string&) override;
   std::string getUrl(const Item&) const;
+
+  class ListObjectsStream;
+  std::string signingKey(const std::string& date,
+                         const std::string& region) const;
   void getRegion(const AuthorizeRequest::Pointer& r,
                  const AuthorizeRequest::AuthorizeCompleted& complete);
   void getEndpoint(const AuthorizeRequest::Pointer& r,
                    const AuthorizeRequest::AuthorizeCompleted& complete);
 
+  using Keys = std::shared_ptr<std::vector<std::string>>;
+  using KeysCompleted = std::function<void(EitherError<void>)>;
+
+  template <class T>
+  void listKeys(const std::shared_ptr<Request<T>>& r,
+                const std::string& prefix, const std::string& page_token,
+                const Keys& keys, const KeysCompleted& complete);
+  template <class T>
+  void deleteKeys(const std::shared_ptr<Request<T>>& r, const Keys& keys,
+                  size_t offset, const KeysCompleted& complete);
+
+  struct SubtreeCopy;
+  using MoveRequest = Request<EitherError<IItem>>;
+  using SubtreeCopyPointer = std::shared_ptr<SubtreeCopy>;
+
+  MoveItemRequest::Pointer moveSubtree(
+      IItem::Pointer item,
+      std::function<std::string(const std::string& key)> destination,
+      MoveItemCallback);
+  void copyKey(const MoveRequest::Pointer& r, const std::string& key,
+               const std::string& destination, const KeysCompleted& complete);
+  void scheduleCopies(const MoveRequest::Pointer& r,
+                      const SubtreeCopyPointer& copy);
+
+  struct MultipartUpload;
+  using UploadRequest = Request<EitherError<IItem>>;
+  using MultipartUploadPointer = std::shared_ptr<MultipartUpload>;
+
+  void createMultipartUpload(const UploadRequest::Pointer& r,
+                             const MultipartUploadPointer& upload);
+  void scheduleParts(const UploadRequest::Pointer& r,
+                     const MultipartUploadPointer& upload);
+  void streamedPart(const UploadRequest::Pointer& r,
+                    const MultipartUploadPointer& upload, uint32_t part,
+                    EitherError<void>);
+  void uploadPart(const UploadRequest::Pointer& r,
+                  const MultipartUploadPointer& upload, uint32_t part);
+  void completeMultipartUpload(const UploadRequest::Pointer& r,
+                               const MultipartUploadPointer& upload);
+  void failMultipartUpload(const UploadRequest::Pointer& r,
+                           const MultipartUploadPointer& upload,
+                           const Error& e);
+  void abortMultipartUpload(const MultipartUpload& upload);
+  uint64_t checksum(const MultipartUpload& upload, uint32_t part);
+  void saveMultipartUpload(const MultipartUpload& upload);
+  void saveMultipartUploadPart(const MultipartUpload& upload, uint32_t part);
+  void removeMultipartUpload(const MultipartUpload& upload);
+
   std::string access_id_;
   std::string secret_;
   std::string region_;
   std::string bucket_;
   std::string s3_endpoint_;
   std::string rewritten_endpoint_;
+  mutable std::mutex signing_key_mutex_;
+  mutable std::string signing_key_;
+  mutable std::string signing_key_date_;
+  mutable std::string signing_key_region_;
+  mutable std::string signing_key_secret_;
+  mutable std::mutex multipart_mutex_;
+  Json::Value multipart_uploads_;
 };
 
 }  // namespace cloudstorage
@@ -44,6 +44,7 @@
 #include "Request/ListDirectoryRequest.h"
 #include "Request/MoveItemRequest.h"
 #include "Request/RenameItemRequest.h"
+#include "Request/SingleFlightRequest.h"
 #include "Request/UploadFileRequest.h"
 
 #undef CreateDirectory
@@ -52,6 +53,8 @@ using namespace std::placeholders;
 
 const std::string DEFAULT_STATE = "DEFAULT_STATE";
 const std::string DEFAULT_FILE_URL = "http://127.0.0.1:12346";
+const uint64_t DEFAULT_DOWNLOAD_CHUNK_SIZE = 8 * 1024 * 1024;
+const uint32_t DEFAULT_RECURSIVE_CONCURRENCY = 4;
 
 namespace {
 
@@ -125,12 +128,39 @@ class UploadFileCallback : public cloudstorage::IUploadFileCallback {
   uint64_t size_;
 };
 
+template <class T, class Callback>
+typename cloudstorage::IRequest<T>::Pointer resolved(
+    std::shared_ptr<cloudstorage::CloudProvider> p, const T& value,
+    const Callback& callback) {
+  return std::make_shared<cloudstorage::Request<T>>(
+             std::move(p), callback,
+             [=](typename cloudstorage::Request<T>::Pointer r) {
+               r->done(value);
+             })
+      ->run();
+}
+
 }  // namespace
 
 namespace cloudstorage {
 
 CloudProvider::CloudProvider(IAuth::Pointer auth)
-    : auth_(std::move(auth)), http_(), deleted_() {}
+    : auth_(std::move(auth)),
+      http_(),
+      http_weight_(1),
+      upload_chunk_size_(),
+      upload_concurrency_(1),
+      download_chunk_size_(DEFAULT_DOWNLOAD_CHUNK_SIZE),
+      download_concurrency_(1),
+      recursive_concurrency_(DEFAULT_RECURSIVE_CONCURRENCY),
+      metadata_cache_(std::make_shared<MetadataCache>()),
+      item_data_flights_(
+          std::make_shared<SingleFlightRequest<EitherError<IItem>>::Group>()),
+      item_url_flights_(std::make_shared<
+                        SingleFlightRequest<EitherError<std::string>>::Group>()),
+      directory_page_flights_(std::make_shared<
+                              SingleFlightRequest<EitherError<PageData>>::Group>()),
+      deleted_() {}
 
 void CloudProvider::initialize(InitData&& data) {
   auto lock = auth_lock();
@@ -163,6 +193,41 @@ void CloudProvider::initialize(InitData&& data) {
               [this](std::string v) { auth()->set_error_page(v); });
   setWithHint(data.hints_, "file_url",
               [this](std::string v) { file_url_ = v; });
+  setWithHint(data.hints_, "http_weight", [this](std::string v) {
+    http_weight_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "upload_chunk_size", [this](std::string v) {
+    upload_chunk_size_ = std::strtoull(v.c_str(), nullptr, 10);
+  });
+  setWithHint(data.hints_, "upload_concurrency", [this](std::string v) {
+    upload_concurrency_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "download_chunk_size", [this](std::string v) {
+    download_chunk_size_ = std::max<uint64_t>(
+        1, std::strtoull(v.c_str(), nullptr, 10));
+  });
+  setWithHint(data.hints_, "download_concurrency", [this](std::string v) {
+    download_concurrency_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "recursive_concurrency", [this](std::string v) {
+    recursive_concurrency_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "metadata_cache_size", [this](std::string v) {
+    metadata_cache_ = std::make_shared<MetadataCache>(
+        std::max(1, std::atoi(v.c_str())));
+  });
+  setWithHint(data.hints_, "item_data_ttl", [this](std::string v) {
+    metadata_cache_->set_item_data_ttl(
+        std::chrono::seconds(std::atoi(v.c_str())));
+  });
+  setWithHint(data.hints_, "item_url_ttl", [this](std::string v) {
+    metadata_cache_->set_item_url_ttl(
+        std::chrono::seconds(std::atoi(v.c_str())));
+  });
+  setWithHint(data.hints_, "directory_page_ttl", [this](std::string v) {
+    metadata_cache_->set_directory_page_ttl(
+        std::chrono::seconds(std::atoi(v.c_str())));
+  });
 
 #ifdef WITH_CRYPTOPP
   if (!crypto_) crypto_ = ICrypto::create();
@@ -279,6 +344,32 @@ ICloudProvider::IAuthCallback* CloudProvider::auth_callback() const {
 
 std::string CloudProvider::file_url() const { return file_url_; }
 
+uint32_t CloudProvider::http_weight() const { return http_weight_; }
+
+uint64_t CloudProvider::upload_chunk_size(uint64_t default_size) const {
+  return upload_chunk_size_ ? upload_chunk_size_ : default_size;
+}
+
+uint32_t CloudProvider::upload_concurrency() const {
+  return upload_concurrency_;
+}
+
+uint64_t CloudProvider::download_chunk_size() const {
+  return download_chunk_size_;
+}
+
+uint32_t CloudProvider::download_concurrency() const {
+  return download_concurrency_;
+}
+
+uint32_t CloudProvider::recursive_concurrency() const {
+  return recursive_concurrency_;
+}
+
+MetadataCache* CloudProvider::metadata_cache() const {
+  return metadata_cache_.get();
+}
+
 ICrypto* CloudProvider::crypto() const { return crypto_.get(); }
 
 IHttp* CloudProvider::http() const { return http_.get(); }
@@ -337,10 +428,25 @@ ICloudProvider::UploadFileRequest::Pointer CloudProvider::uploadFileAsync(
       ->run();
 }
 
+ICloudProvider::UploadFileRequest::Pointer CloudProvider::uploadFileStreamAsync(
+    IItem::Pointer, const std::string&, IUploadStreamCallback::Pointer) {
+  return nullptr;
+}
+
 ICloudProvider::GetItemDataRequest::Pointer CloudProvider::getItemDataAsync(
     const std::string& id, GetItemDataCallback f) {
-  return std::make_shared<cloudstorage::GetItemDataRequest>(shared_from_this(),
-                                                            id, f)
+  auto p = shared_from_this();
+  auto cached = metadata_cache()->itemData(id);
+  if (cached && cached->fresh())
+    return resolved(p, EitherError<IItem>(cached->value_), f);
+  return std::make_shared<SingleFlightRequest<EitherError<IItem>>>(
+             p, item_data_flights_, id,
+             [=](const GetItemDataCallback& callback) {
+               return std::make_shared<cloudstorage::GetItemDataRequest>(
+                          p, id, callback)
+                   ->run();
+             },
+             f)
       ->run();
 }
 
@@ -453,6 +559,11 @@ ICloudProvider::DownloadFileRequest::Pointer CloudProvider::getThumbnailAsync(
     IDownloadFileCallback::Pointer callback_;
     std::function<void(EitherError<void>)> continuation_;
   };
+  auto thumbnail_request = [this](const IItem& item, std::ostream& stream) {
+    auto request = getThumbnailRequest(item, stream);
+    if (request) request->setPriority(IHttpRequest::Priority::Background);
+    return request;
+  };
   auto first_try = [=, this](Request<EitherError<void>>::Pointer r) {
     return std::make_shared<DownloadCallback>(
         callback, [=, this](EitherError<void> e) {
@@ -467,9 +578,7 @@ ICloudProvider::DownloadFileRequest::Pointer CloudProvider::getThumbnailAsync(
                 previous_item->set_thumbnail_url(current_item->thumbnail_url());
                 r->make_subrequest(
                     &CloudProvider::makeDownloadFileRequest, e.right(),
-                    FullRange,
-                    std::bind(&CloudProvider::getThumbnailRequest, this, _1,
-                              _2),
+                    FullRange, thumbnail_request,
                     std::make_shared<DownloadCallback>(
                         callback, [=](EitherError<void> e) { r->done(e); }));
               });
@@ -478,8 +587,7 @@ ICloudProvider::DownloadFileRequest::Pointer CloudProvider::getThumbnailAsync(
   auto resolver = [=, this](Request<EitherError<void>>::Pointer r) {
     r->make_subrequest(
         &CloudProvider::makeDownloadFileRequest, item, FullRange,
-        std::bind(&CloudProvider::getThumbnailRequest, this, _1, _2),
-        first_try(r));
+        thumbnail_request, first_try(r));
   };
   return std::make_shared<Request<EitherError<void>>>(
              shared_from_this(),
@@ -520,8 +628,25 @@ ICloudProvider::RenameItemRequest::Pointer CloudProvider::renameItemAsync(
 
 ICloudProvider::GetItemUrlRequest::Pointer CloudProvider::getItemUrlAsync(
     IItem::Pointer i, GetItemUrlCallback callback) {
-  return std::make_shared<cloudstorage::GetItemUrlRequest>(shared_from_this(),
-                                                           i, callback)
+  auto p = shared_from_this();
+  auto cached = metadata_cache()->itemUrl(i->id());
+  if (cached && cached->fresh()) {
+    static_cast<Item*>(i.get())->set_url(cached->value_);
+    return resolved(p, EitherError<std::string>(cached->value_), callback);
+  }
+  return std::make_shared<SingleFlightRequest<EitherError<std::string>>>(
+             p, item_url_flights_, i->id(),
+             [=](const GetItemUrlCallback& callback) {
+               return std::make_shared<cloudstorage::GetItemUrlRequest>(
+                          p, i, callback)
+                   ->run();
+             },
+             [=](EitherError<std::string> e) {
+               // Only the item of the caller who started the request got
+               // its url set there; other waiters hold items of their own.
+               if (e.right()) static_cast<Item*>(i.get())->set_url(*e.right());
+               callback(e);
+             })
       ->run();
 }
 
@@ -529,8 +654,37 @@ ICloudProvider::ListDirectoryPageRequest::Pointer
 CloudProvider::listDirectoryPageAsync(IItem::Pointer directory,
                                       const std::string& token,
                                       ListDirectoryPageCallback completed) {
-  return std::make_shared<cloudstorage::ListDirectoryPageRequest>(
-             shared_from_this(), directory, token, completed)
+  return listDirectoryPage(directory, token, nullptr, completed);
+}
+
+ICloudProvider::ListDirectoryPageRequest::Pointer
+CloudProvider::streamDirectoryPageAsync(IItem::Pointer directory,
+                                        const std::string& token,
+                                        ReceivedItemCallback received,
+                                        ListDirectoryPageCallback completed) {
+  // Providers which don't stream may list directories their own way.
+  if (!supportsListDirectoryStream())
+    return listDirectoryPageAsync(directory, token, completed);
+  return listDirectoryPage(directory, token, received, completed);
+}
+
+ICloudProvider::ListDirectoryPageRequest::Pointer
+CloudProvider::listDirectoryPage(IItem::Pointer directory,
+                                 const std::string& token,
+                                 ReceivedItemCallback received,
+                                 ListDirectoryPageCallback completed) {
+  auto p = shared_from_this();
+  auto cached = metadata_cache()->directoryPage(directory->id(), token);
+  if (cached && cached->fresh())
+    return resolved(p, EitherError<PageData>(cached->value_), completed);
+  return std::make_shared<SingleFlightRequest<EitherError<PageData>>>(
+             p, directory_page_flights_, directory->id() + "\n" + token,
+             [=](const ListDirectoryPageCallback& callback) {
+               return std::make_shared<cloudstorage::ListDirectoryPageRequest>(
+                          p, directory, token, callback, received)
+                   ->run();
+             },
+             completed)
       ->run();
 }
 
@@ -716,6 +870,14 @@ IItem::List CloudProvider::listDirectoryResponse(const IItem&, std::istream&,
   return {};
 }
 
+std::shared_ptr<CloudProvider::ListDirectoryStream>
+CloudProvider::listDirectoryStream(const IItem&,
+                                   const ReceivedItemCallback&) const {
+  return nullptr;
+}
+
+bool CloudProvider::supportsListDirectoryStream() const { return false; }
+
 IItem::Pointer CloudProvider::createDirectoryResponse(
     const IItem&, const std::string&, std::istream& stream) const {
   return getItemDataResponse(stream);
@@ -744,4 +906,22 @@ CloudProvider::downloadFileRangeAsync(IItem::Pointer item, Range range,
   return downloadFileAsync(std::move(item), std::move(callback), range);
 }
 
+ICloudProvider::DownloadFileRequest::Pointer
+CloudProvider::downloadFileParallelAsync(IItem::Pointer item,
+                                         IDownloadFileCallback::Pointer callback,
+                                         Range range) {
+  auto size = range.size_;
+  if (size == Range::Full && item->size() != IItem::UnknownSize &&
+      range.start_ <= item->size())
+    size = item->size() - range.start_;
+  if (download_concurrency() <= 1 || size == Range::Full ||
+      size <= download_chunk_size())
+    return downloadFileAsync(std::move(item), std::move(callback), range);
+  return std::make_shared<ParallelDownloadFileRequest>(
+             shared_from_this(), std::move(item), std::move(callback),
+             Range{range.start_, size}, download_chunk_size(),
+             download_concurrency())
+      ->run();
+}
+
 }  // namespace cloudstorage
@@ -32,7 +32,9 @@
 
 #include "ICloudProvider.h"
 #include "Request/AuthorizeRequest.h"
+#include "Request/SingleFlightRequest.h"
 #include "Utility/Auth.h"
+#include "Utility/MetadataCache.h"
 
 namespace cloudstorage {
 
@@ -40,6 +42,24 @@ class CloudProvider : public ICloudProvider,
                       public std::enable_shared_from_this<CloudProvider> {
  public:
   using Pointer = std::shared_ptr<CloudProvider>;
+  using ReceivedItemCallback = std::function<void(IItem::Pointer)>;
+
+  /**
+   * Stream to which the response of listDirectoryRequest is written while
+   * it's received.
+   */
+  class ListDirectoryStream : public std::ostream {
+   public:
+    using std::ostream::ostream;
+
+    /**
+     * Called once the whole response was written.
+     *
+     * @param next_page_token set like in listDirectoryResponse
+     * @return items of the page, in the order they were received
+     */
+    virtual IItem::List finish(std::string& next_page_token) = 0;
+  };
 
   CloudProvider(IAuth::Pointer);
 
@@ -61,6 +81,13 @@ class CloudProvider : public ICloudProvider,
   IThreadPool* thumbnailer_thread_pool() const;
   IAuthCallback* auth_callback() const;
   std::string file_url() const;
+  uint32_t http_weight() const;
+  uint64_t upload_chunk_size(uint64_t default_size) const;
+  uint32_t upload_concurrency() const;
+  uint64_t download_chunk_size() const;
+  uint32_t download_concurrency() const;
+  uint32_t recursive_concurrency() const;
+  MetadataCache* metadata_cache() const;
 
   virtual bool isSuccess(int code, const IHttpRequest::HeaderParameters&) const;
 
@@ -80,6 +107,9 @@ class CloudProvider : public ICloudProvider,
   UploadFileRequest::Pointer uploadFileAsync(
       IItem::Pointer, const std::string&,
       IUploadFileCallback::Pointer) override;
+  UploadFileRequest::Pointer uploadFileStreamAsync(
+      IItem::Pointer, const std::string&,
+      IUploadStreamCallback::Pointer) override;
   GetItemDataRequest::Pointer getItemDataAsync(const std::string& id,
                                                GetItemDataCallback f) override;
   DownloadFileRequest::Pointer getThumbnailAsync(
@@ -97,6 +127,15 @@ class CloudProvider : public ICloudProvider,
                                              RenameItemCallback) override;
   ListDirectoryPageRequest::Pointer listDirectoryPageAsync(
       IItem::Pointer, const std::string&, ListDirectoryPageCallback) override;
+
+  /**
+   * Like listDirectoryPageAsync, but if the page is downloaded by this
+   * request and the provider supports listDirectoryStream, items are passed
+   * to received while the response is parsed.
+   */
+  ListDirectoryPageRequest::Pointer streamDirectoryPageAsync(
+      IItem::Pointer, const std::string&, ReceivedItemCallback received,
+      ListDirectoryPageCallback);
   ListDirectoryRequest::Pointer listDirectorySimpleAsync(
       IItem::Pointer item, ListDirectoryCallback callback) override;
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer item,
@@ -240,6 +279,19 @@ class CloudProvider : public ICloudProvider,
                                             std::istream& response,
                                             std::string& next_page_token) const;
 
+  /**
+   * Used by default implementation of listDirectoryAsync instead of
+   * listDirectoryResponse, if it doesn't return nullptr; every item should be
+   * passed to received as soon as it's parsed.
+   */
+  virtual std::shared_ptr<ListDirectoryStream> listDirectoryStream(
+      const IItem& directory, const ReceivedItemCallback& received) const;
+
+  /**
+   * Should return true if listDirectoryStream is overridden.
+   */
+  virtual bool supportsListDirectoryStream() const;
+
   virtual IItem::Pointer renameItemResponse(const IItem& old_item,
                                             const std::string& name,
                                             std::istream& response) const;
@@ -299,6 +351,14 @@ class CloudProvider : public ICloudProvider,
   DownloadFileRequest::Pointer downloadFileRangeAsync(
       IItem::Pointer, Range, IDownloadFileCallback::Pointer);
 
+  /**
+   * Splits the range into download_chunk_size pieces and fetches
+   * download_concurrency of them at once with downloadFileAsync; falls back
+   * to a single downloadFileAsync when the range is small or of unknown size.
+   */
+  DownloadFileRequest::Pointer downloadFileParallelAsync(
+      IItem::Pointer, IDownloadFileCallback::Pointer, Range);
+
  protected:
   void setWithHint(const Hints& hints, const std::string& name,
                    const std::function<void(std::string)>&) const;
@@ -314,6 +374,9 @@ class CloudProvider : public ICloudProvider,
       IItem::Pointer file, Range,
       std::function<IHttpRequest::Pointer(const IItem&, std::ostream&)>,
       IDownloadFileCallback::Pointer);
+  ListDirectoryPageRequest::Pointer listDirectoryPage(
+      IItem::Pointer, const std::string& token, ReceivedItemCallback,
+      ListDirectoryPageCallback);
 
   IAuth::Pointer auth_;
   IAuthCallback::Pointer callback_;
@@ -329,6 +392,19 @@ class CloudProvider : public ICloudProvider,
   std::unordered_set<std::shared_ptr<ICloudProvider::DownloadFileRequest>>
       stream_requests_;
   std::string file_url_;
+  uint32_t http_weight_;
+  uint64_t upload_chunk_size_;
+  uint32_t upload_concurrency_;
+  uint64_t download_chunk_size_;
+  uint32_t download_concurrency_;
+  uint32_t recursive_concurrency_;
+  std::shared_ptr<MetadataCache> metadata_cache_;
+  std::shared_ptr<SingleFlightRequest<EitherError<IItem>>::Group>
+      item_data_flights_;
+  std::shared_ptr<SingleFlightRequest<EitherError<std::string>>::Group>
+      item_url_flights_;
+  std::shared_ptr<SingleFlightRequest<EitherError<PageData>>::Group>
+      directory_page_flights_;
   IHttpServer::Pointer file_daemon_;
   std::mutex stream_request_mutex_;
   std::mutex current_authorization_mutex_;
@@ -25,50 +25,82 @@
 
 #include <json/json.h>
 #include <algorithm>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 #include "Utility/Item.h"
 #include "Utility/Utility.h"
 
 #include "Request/Request.h"
+#include "Request/UploadFileRequest.h"
 
 const std::string DROPBOXAPI_ENDPOINT = "https://api.dropboxapi.com";
-const int CHUNK_SIZE = 60 * 1024 * 1024;
+const uint64_t CHUNK_SIZE = 60 * 1024 * 1024;
+const uint64_t MAX_CHUNK_SIZE = 150 * 1024 * 1024;
+const uint64_t CONCURRENT_CHUNK_ALIGNMENT = 4 * 1024 * 1024;
+
+using namespace std::placeholders;
 
 namespace cloudstorage {
 
 namespace {
-void upload(const Request<EitherError<IItem>>::Pointer& r,
-            const std::string& session_id, const std::string& path,
-            uint64_t sent, IUploadFileCallback* callback) {
+
+using UploadRequest = Request<EitherError<IItem>>;
+
+struct ConcurrentUpload {
+  using Pointer = std::shared_ptr<ConcurrentUpload>;
+
+  IUploadFileCallback* callback_;
+  std::string path_;
+  std::string session_id_;
+  uint64_t size_;
+  uint64_t chunk_size_;
+  uint32_t concurrency_;
+  std::mutex mutex_;
+  uint64_t next_ = 0;
+  uint64_t uploaded_ = 0;
+  uint32_t running_ = 0;
+  bool failed_ = false;
+  std::unordered_map<uint64_t, uint64_t> progress_;
+};
+
+IHttpRequest::Pointer session_request(const UploadRequest::Pointer& r,
+                                      const std::string& method,
+                                      const Json::Value& json) {
+  auto request = r->provider()->http()->create(
+      "https://content.dropboxapi.com/2/files/upload_session/" + method,
+      "POST");
+  request->setHeaderParameter("Content-Type", "application/octet-stream");
+  request->setHeaderParameter("Dropbox-API-Arg", util::json::to_string(json));
+  return request;
+}
+
+void upload(const UploadRequest::Pointer& r, const std::string& session_id,
+            const std::string& path, uint64_t sent,
+            IUploadFileCallback* callback, uint64_t chunk_size) {
   auto size = callback->size();
-  auto length = std::make_shared<uint64_t>(0);
+  auto length = sent < size ? std::min(chunk_size, size - sent) : 0;
+  auto wrapper = std::make_shared<UploadChunkStreamWrapper>(
+      std::bind(&IUploadFileCallback::putData, callback, _1, _2, _3), sent,
+      length);
   r->send(
-      [=](util::Output stream) {
-        std::vector<char> buffer(CHUNK_SIZE);
-        if (sent < size)
-          *length = callback->putData(buffer.data(), CHUNK_SIZE, sent);
-        std::string upload_url =
-            "https://content.dropboxapi.com/2/files/upload_session";
+      [=](util::Output) {
+        std::string method;
         Json::Value json;
         if (sent == 0)
-          upload_url += "/start";
-        else if (sent + *length >= size) {
+          method = "start";
+        else if (sent + length >= size) {
           json["commit"]["path"] = path;
           json["commit"]["mode"] = "overwrite";
-          upload_url += "/finish";
+          method = "finish";
         } else
-          upload_url += "/append_v2";
-        auto request = r->provider()->http()->create(upload_url, "POST");
+          method = "append_v2";
         if (sent != 0) {
           json["cursor"]["session_id"] = session_id;
           json["cursor"]["offset"] = Json::Int64(static_cast<int64_t>(sent));
         }
-        request->setHeaderParameter("Content-Type", "application/octet-stream");
-        request->setHeaderParameter("Dropbox-API-Arg",
-                                    util::json::to_string(json));
-        stream->write(buffer.data(), *length);
-        return request;
+        return session_request(r, method, json);
       },
       [=](EitherError<Response> e) {
         if (e.left()) return r->done(e.left());
@@ -78,18 +110,130 @@ void upload(const Request<EitherError<IItem>>::Pointer& r,
             upload(
                 r,
                 session_id.empty() ? json["session_id"].asString() : session_id,
-                path, sent + *length, callback);
+                path, sent + length, callback, chunk_size);
           else
             r->done(Dropbox::toItem(json));
         } catch (const Json::Exception&) {
           r->done(Error{IHttpRequest::Failure, e.right()->output().str()});
         }
       },
-      [] { return std::make_shared<std::stringstream>(); },
-      std::make_shared<std::stringstream>(), nullptr,
+      [=] {
+        wrapper->reset();
+        return std::make_shared<std::iostream>(wrapper.get());
+      },
+      std::make_shared<util::MemoryStream>(), nullptr,
       [=](uint64_t, uint64_t now) { callback->progress(size, sent + now); },
       true);
 }
+
+void finish(const UploadRequest::Pointer& r,
+            const ConcurrentUpload::Pointer& upload) {
+  r->request(
+      [=](util::Output) {
+        Json::Value json;
+        json["cursor"]["session_id"] = upload->session_id_;
+        json["cursor"]["offset"] =
+            Json::Int64(static_cast<int64_t>(upload->size_));
+        json["commit"]["path"] = upload->path_;
+        json["commit"]["mode"] = "overwrite";
+        return session_request(r, "finish", json);
+      },
+      [=](EitherError<Response> e) {
+        if (e.left()) return r->done(e.left());
+        try {
+          r->done(Dropbox::toItem(util::json::from_stream(e.right()->output())));
+        } catch (const Json::Exception&) {
+          r->done(Error{IHttpRequest::Failure, e.right()->output().str()});
+        }
+      });
+}
+
+void schedule(const UploadRequest::Pointer& r,
+              const ConcurrentUpload::Pointer& upload);
+
+void append(const UploadRequest::Pointer& r,
+            const ConcurrentUpload::Pointer& upload, uint64_t offset,
+            uint64_t length) {
+  auto wrapper = std::make_shared<UploadChunkStreamWrapper>(
+      std::bind(&IUploadFileCallback::putData, upload->callback_, _1, _2, _3),
+      offset, length);
+  r->send(
+      [=](util::Output) {
+        Json::Value json;
+        json["cursor"]["session_id"] = upload->session_id_;
+        json["cursor"]["offset"] = Json::Int64(static_cast<int64_t>(offset));
+        json["close"] = offset + length == upload->size_;
+        return session_request(r, "append_v2", json);
+      },
+      [=](EitherError<Response> e) {
+        std::unique_lock<std::mutex> lock(upload->mutex_);
+        upload->running_--;
+        upload->progress_.erase(offset);
+        if (upload->failed_) return;
+        if (e.left()) {
+          upload->failed_ = true;
+          lock.unlock();
+          return r->done(e.left());
+        }
+        upload->uploaded_ += length;
+        bool finished = upload->running_ == 0 && upload->next_ == upload->size_;
+        lock.unlock();
+        if (finished)
+          finish(r, upload);
+        else
+          schedule(r, upload);
+      },
+      [=] {
+        wrapper->reset();
+        return std::make_shared<std::iostream>(wrapper.get());
+      },
+      std::make_shared<util::MemoryStream>(), nullptr,
+      [=](uint64_t, uint64_t now) {
+        std::unique_lock<std::mutex> lock(upload->mutex_);
+        upload->progress_[offset] = now;
+        auto sent = upload->uploaded_;
+        for (const auto& p : upload->progress_) sent += p.second;
+        lock.unlock();
+        upload->callback_->progress(upload->size_, sent);
+      },
+      true);
+}
+
+void schedule(const UploadRequest::Pointer& r,
+              const ConcurrentUpload::Pointer& upload) {
+  std::unique_lock<std::mutex> lock(upload->mutex_);
+  while (!upload->failed_ && upload->running_ < upload->concurrency_ &&
+         upload->next_ < upload->size_) {
+    auto offset = upload->next_;
+    auto length = std::min(upload->chunk_size_, upload->size_ - offset);
+    upload->next_ += length;
+    upload->running_++;
+    lock.unlock();
+    append(r, upload, offset, length);
+    lock.lock();
+  }
+}
+
+void upload_concurrent(const UploadRequest::Pointer& r,
+                       const ConcurrentUpload::Pointer& upload) {
+  r->request(
+      [=](util::Output) {
+        Json::Value json;
+        json["session_type"] = "concurrent";
+        return session_request(r, "start", json);
+      },
+      [=](EitherError<Response> e) {
+        if (e.left()) return r->done(e.left());
+        try {
+          auto json = util::json::from_stream(e.right()->output());
+          upload->session_id_ = json["session_id"].asString();
+          schedule(r, upload);
+        } catch (const Json::Exception&) {
+          r->done(Error{IHttpRequest::Failure, e.right()->output().str()});
+        }
+      });
+}
+
 }  // namespace
 
 Dropbox::Dropbox() : CloudProvider(util::make_unique<Auth>()) {}
@@ -122,10 +266,27 @@ ICloudProvider::UploadFileRequest::Pointer Dropbox::uploadFileAsync(
     IItem::Pointer parent, const std::string& filename,
     IUploadFileCallback::Pointer cb) {
   auto callback = cb.get();
-  return std::make_shared<Request<EitherError<IItem>>>(
+  auto path = parent->id() + "/" + filename;
+  auto chunk_size = std::min(upload_chunk_size(CHUNK_SIZE), MAX_CHUNK_SIZE);
+  auto concurrency = upload_concurrency();
+  return std::make_shared<UploadRequest>(
              shared_from_this(), [=](EitherError<IItem> e) { cb->done(e); },
-             [=](Request<EitherError<IItem>>::Pointer r) {
-               upload(r, "", parent->id() + "/" + filename, 0, callback);
+             [=](UploadRequest::Pointer r) {
+               auto size = callback->size();
+               if (concurrency <= 1 || size <= chunk_size)
+                 return upload(r, "", path, 0, callback, chunk_size);
+               // Every chunk of a concurrent session but the last one has to
+               // be a multiple of 4 MiB.
+               auto session = std::make_shared<ConcurrentUpload>();
+               session->callback_ = callback;
+               session->path_ = path;
+               session->size_ = size;
+               session->chunk_size_ =
+                   std::max(CONCURRENT_CHUNK_ALIGNMENT,
+                            chunk_size / CONCURRENT_CHUNK_ALIGNMENT *
+                                CONCURRENT_CHUNK_ALIGNMENT);
+               session->concurrency_ = concurrency;
+               upload_concurrent(r, session);
              })
       ->run();
 }
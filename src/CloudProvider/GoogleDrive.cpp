@@ -229,7 +229,7 @@ ICloudProvider::UploadFileRequest::Pointer GoogleDrive::uploadFileAsync(
             }
           },
           [=] { return std::make_shared<std::iostream>(stream_wrapper.get()); },
-          std::make_shared<std::stringstream>(), nullptr,
+          std::make_shared<util::MemoryStream>(), nullptr,
           std::bind(&IUploadFileCallback::progress, cb, _1, _2), true);
     };
     r->make_subrequest(&GoogleDrive::listDirectorySimpleAsync, directory,
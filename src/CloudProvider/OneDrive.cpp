@@ -24,14 +24,17 @@
 #include "OneDrive.h"
 
 #include <json/json.h>
+#include <algorithm>
 #include <sstream>
 
 #include <iostream>
 #include "Request/Request.h"
+#include "Request/UploadFileRequest.h"
 #include "Utility/Item.h"
 #include "Utility/Utility.h"
 
-const uint32_t CHUNK_SIZE = 60 * 1024 * 1024;
+const uint64_t CHUNK_SIZE = 60 * 1024 * 1024;
+const uint64_t CHUNK_ALIGNMENT = 320 * 1024;
 using namespace std::placeholders;
 
 namespace cloudstorage {
@@ -39,35 +42,39 @@ namespace cloudstorage {
 namespace {
 void upload(const Request<EitherError<IItem>>::Pointer& r,
             const std::string& upload_url, uint64_t sent,
-            IUploadFileCallback* callback, const Json::Value& response) {
+            IUploadFileCallback* callback, const Json::Value& response,
+            uint64_t chunk_size) {
   auto size = callback->size();
-  auto length = std::make_shared<uint64_t>(0);
   if (sent >= size)
     return r->done(
         static_cast<OneDrive*>(r->provider().get())->toItem(response));
+  auto length = std::min(chunk_size, size - sent);
+  auto wrapper = std::make_shared<UploadChunkStreamWrapper>(
+      std::bind(&IUploadFileCallback::putData, callback, _1, _2, _3), sent,
+      length);
   r->send(
-      [=](util::Output stream) {
-        std::vector<char> buffer(CHUNK_SIZE);
-        *length = callback->putData(buffer.data(), CHUNK_SIZE, sent);
+      [=](util::Output) {
         auto request = r->provider()->http()->create(upload_url, "PUT");
         std::stringstream content_range;
-        content_range << "bytes " << sent << "-" << sent + *length - 1 << "/"
+        content_range << "bytes " << sent << "-" << sent + length - 1 << "/"
                       << size;
         request->setHeaderParameter("Content-Range", content_range.str());
-        stream->write(buffer.data(), *length);
         return request;
       },
       [=](EitherError<Response> e) {
         if (e.left()) return r->done(e.left());
         try {
           auto json = util::json::from_stream(e.right()->output());
-          upload(r, upload_url, sent + *length, callback, json);
+          upload(r, upload_url, sent + length, callback, json, chunk_size);
         } catch (const Json::Exception&) {
           r->done(Error{IHttpRequest::Failure, e.right()->output().str()});
         }
       },
-      [] { return std::make_shared<std::stringstream>(); },
-      std::make_shared<std::stringstream>(), nullptr,
+      [=] {
+        wrapper->reset();
+        return std::make_shared<std::iostream>(wrapper.get());
+      },
+      std::make_shared<util::MemoryStream>(), nullptr,
       [=](uint64_t, uint64_t now) { callback->progress(size, sent + now); },
       true);
 }
@@ -142,6 +149,12 @@ ICloudProvider::UploadFileRequest::Pointer OneDrive::uploadFileAsync(
     IItem::Pointer parent, const std::string& filename,
     IUploadFileCallback::Pointer cb) {
   auto callback = cb.get();
+  // Fragments of an upload session have to be sent in order, so
+  // upload_concurrency doesn't apply; chunks must be multiples of 320 KiB.
+  auto chunk_size =
+      std::max(CHUNK_ALIGNMENT,
+               std::min(upload_chunk_size(CHUNK_SIZE), CHUNK_SIZE) /
+                   CHUNK_ALIGNMENT * CHUNK_ALIGNMENT);
   return std::make_shared<Request<EitherError<IItem>>>(
              shared_from_this(), [=](EitherError<IItem> e) { cb->done(e); },
              [=, this](Request<EitherError<IItem>>::Pointer r) {
@@ -159,7 +172,7 @@ ICloudProvider::UploadFileRequest::Pointer OneDrive::uploadFileAsync(
                        auto response =
                            util::json::from_stream(e.right()->output());
                        upload(r, response["uploadUrl"].asString(), 0, callback,
-                              response);
+                              response, chunk_size);
                      } catch (const Json::Exception& e) {
                        r->done(Error{IHttpRequest::Failure, e.what()});
                      }
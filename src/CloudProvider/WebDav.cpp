@@ -25,9 +25,9 @@
 
 #include "Request/AuthorizeRequest.h"
 #include "Utility/Item.h"
+#include "Utility/XmlStreamParser.h"
 
 #include <json/json.h>
-#include <cstring>
 #include <iomanip>
 #include <iostream>
 
@@ -47,23 +47,92 @@ IItem::TimeStamp parse_time(const std::string& str) {
   }
 }
 
-bool ends_with(const char* str, const char* pattern) {
-  auto l1 = strlen(str);
-  auto l2 = strlen(pattern);
-  if (l1 < l2) return false;
-  for (auto i = 0u; i < l2; i++)
-    if (str[i + l1 - l2] != pattern[i]) return false;
-  return true;
-}
+// Reports every response of a PROPFIND multistatus as soon as it ends.
+class MultiStatusParser : public util::XmlStreamParser {
+ public:
+  using Callback = std::function<void(const WebDav::Properties&)>;
+
+  MultiStatusParser(const Callback& callback)
+      : XmlStreamParser([this](const Path& path) { start(path); },
+                        [this](const Path& path, const std::string& text) {
+                          end(path, text);
+                        }),
+        callback_(callback),
+        propstat_count_() {}
+
+ private:
+  void start(const Path& path) {
+    if (path.size() == 2 && path[1] == "response") {
+      properties_ = {};
+      propstat_count_ = 0;
+    } else if (path.size() == 3 && path[2] == "propstat") {
+      propstat_count_++;
+    } else if (propstat_count_ == 1 && path.size() == 6 &&
+               path[2] == "propstat" && path[3] == "prop" &&
+               path[4] == "resourcetype" && path[5] == "collection") {
+      properties_.collection_ = true;
+    }
+  }
 
-const tinyxml2::XMLElement* find(const tinyxml2::XMLElement* parent,
-                                 const char* name, bool except = true) {
-  for (auto element = parent->FirstChildElement(); element;
-       element = element->NextSiblingElement()) {
-    if (element->Name() && ends_with(element->Name(), name)) return element;
+  void end(const Path& path, const std::string& text) {
+    if (path.size() == 3 && path[2] == "href") {
+      properties_.href_ = text;
+    } else if (propstat_count_ == 1 && path.size() == 5 &&
+               path[2] == "propstat" && path[3] == "prop") {
+      properties_.values_[path[4]] = text;
+    } else if (path.size() == 2 && path[1] == "response") {
+      callback_(properties_);
+    }
   }
-  if (except) throw std::logic_error(util::Error::INVALID_XML);
-  return nullptr;
+
+  Callback callback_;
+  WebDav::Properties properties_;
+  int propstat_count_;
+};
+
+// Items of a PROPFIND listing, which starts with the directory itself.
+class PropfindStream : public CloudProvider::ListDirectoryStream {
+ public:
+  PropfindStream(const WebDav* provider,
+                 const CloudProvider::ReceivedItemCallback& received)
+      : ListDirectoryStream(nullptr),
+        parser_([this, provider, received](
+            const WebDav::Properties& properties) {
+          if (!directory_) {
+            directory_ = true;
+            return;
+          }
+          auto item = provider->toItem(properties);
+          items_.push_back(item);
+          if (received) received(item);
+        }),
+        directory_() {
+    init(&parser_);
+  }
+
+  IItem::List finish(std::string&) override {
+    parser_.finish();
+    return std::move(items_);
+  }
+
+ private:
+  MultiStatusParser parser_;
+  IItem::List items_;
+  bool directory_;
+};
+
+void parse(std::istream& stream, util::XmlStreamParser& parser) {
+  std::string storage;
+  parser.parse(util::view(stream, storage));
+  parser.finish();
+}
+
+const std::string& find(const WebDav::Properties& properties,
+                        const std::string& name) {
+  auto it = properties.values_.find(name);
+  if (it == properties.values_.end())
+    throw std::logic_error(util::Error::INVALID_XML);
+  return it->second;
 }
 
 }  // namespace
@@ -195,21 +264,18 @@ IItem::Pointer WebDav::uploadFileResponse(const IItem& item,
 }
 
 GeneralData WebDav::getGeneralDataResponse(std::istream& stream) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str()) != tinyxml2::XML_SUCCESS)
-    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
-  auto response = find(document.RootElement(), "response");
-  auto propstat = find(response, "propstat");
-  auto prop = find(propstat, "prop");
-  auto quota_used = find(prop, "quota-used-bytes");
-  auto quota_available = find(prop, "quota-available-bytes");
+  std::unique_ptr<Properties> response;
+  MultiStatusParser parser([&](const Properties& properties) {
+    if (!response) response = util::make_unique<Properties>(properties);
+  });
+  parse(stream, parser);
+  if (!response) throw std::logic_error(util::Error::INVALID_XML);
+  const auto& quota_used = find(*response, "quota-used-bytes");
+  const auto& quota_available = find(*response, "quota-available-bytes");
   GeneralData data;
-  data.space_used_ =
-      quota_used->GetText() ? std::stoull(quota_used->GetText()) : 0;
+  data.space_used_ = quota_used.empty() ? 0 : std::stoull(quota_used);
   data.space_total_ =
-      quota_available->GetText() ? std::stoull(quota_available->GetText()) : 0;
+      quota_available.empty() ? 0 : std::stoull(quota_available);
   auto lock = auth_lock();
   auto url = util::Url(endpoint_);
   data.username_ = url.protocol() + "://" + user_ + "@" + url.host() +
@@ -218,12 +284,13 @@ GeneralData WebDav::getGeneralDataResponse(std::istream& stream) const {
 }
 
 IItem::Pointer WebDav::getItemDataResponse(std::istream& stream) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str()) != tinyxml2::XML_SUCCESS)
-    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
-  return toItem(document.RootElement()->FirstChildElement());
+  IItem::Pointer item;
+  MultiStatusParser parser([&](const Properties& properties) {
+    if (!item) item = toItem(properties);
+  });
+  parse(stream, parser);
+  if (!item) throw std::logic_error(util::Error::INVALID_XML);
+  return item;
 }
 
 IItem::Pointer WebDav::renameItemResponse(const IItem& item,
@@ -251,41 +318,39 @@ IItem::Pointer WebDav::moveItemResponse(const IItem& source, const IItem& dest,
 }
 
 IItem::List WebDav::listDirectoryResponse(const IItem&, std::istream& stream,
-                                          std::string&) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str()) != tinyxml2::XML_SUCCESS)
-    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
-  if (document.RootElement()->FirstChild() == nullptr) return {};
-
-  IItem::List result;
-  for (auto child = document.RootElement()->FirstChild()->NextSiblingElement();
-       child; child = child->NextSiblingElement()) {
-    result.push_back(toItem(child));
-  }
-  return result;
+                                          std::string& next_page_token) const {
+  std::string storage;
+  auto content = util::view(stream, storage);
+  PropfindStream list(this, nullptr);
+  list.write(content.data(), static_cast<std::streamsize>(content.size()));
+  return list.finish(next_page_token);
 }
 
-IItem::Pointer WebDav::toItem(const tinyxml2::XMLElement* node) const {
-  if (!node) throw std::logic_error(util::Error::INVALID_XML);
-  auto element = find(node, "href");
-  auto propstat = find(node, "propstat");
-  auto prop = find(propstat, "prop");
+std::shared_ptr<CloudProvider::ListDirectoryStream> WebDav::listDirectoryStream(
+    const IItem&, const ReceivedItemCallback& received) const {
+  return std::make_shared<PropfindStream>(this, received);
+}
+
+bool WebDav::supportsListDirectoryStream() const { return true; }
+
+IItem::Pointer WebDav::toItem(const Properties& properties) const {
+  if (properties.href_.empty())
+    throw std::logic_error(util::Error::INVALID_XML);
   auto size = IItem::UnknownSize;
   auto timestamp = IItem::UnknownTimeStamp;
   auto type = IItem::FileType::Unknown;
-  if (auto size_element = find(prop, "getcontentlength", false))
-    if (auto text = size_element->GetText()) size = std::stoull(text);
-  if (auto timestamp_element = find(prop, "getlastmodified", false))
-    if (auto text = timestamp_element->GetText()) timestamp = parse_time(text);
-  if (auto resource_type = find(prop, "resourcetype", false))
-    if (find(resource_type, "collection", false)) {
-      type = IItem::FileType::Directory;
-    }
+  auto value = [&](const std::string& name) {
+    auto it = properties.values_.find(name);
+    return it != properties.values_.end() ? it->second : "";
+  };
+  if (!value("getcontentlength").empty())
+    size = std::stoull(value("getcontentlength"));
+  if (!value("getlastmodified").empty())
+    timestamp = parse_time(value("getlastmodified"));
+  if (properties.collection_) type = IItem::FileType::Directory;
   auto lock = auth_lock();
   auto url = util::Url(endpoint_);
-  std::string id = element->GetText();
+  std::string id = properties.href_;
   id = id.substr(url.path().length());
   if (id.back() == '/') type = IItem::FileType::Directory;
   std::string filename = id;
@@ -24,7 +24,7 @@
 #ifndef WEBDAV_H
 #define WEBDAV_H
 
-#include <tinyxml2.h>
+#include <unordered_map>
 
 #include "CloudProvider.h"
 
@@ -77,6 +77,9 @@ class WebDav : public CloudProvider {
   IItem::Pointer getItemDataResponse(std::istream& response) const override;
   IItem::List listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  std::shared_ptr<ListDirectoryStream> listDirectoryStream(
+      const IItem&, const ReceivedItemCallback&) const override;
+  bool supportsListDirectoryStream() const override;
   IItem::Pointer renameItemResponse(const IItem& old_item,
                                     const std::string& name,
                                     std::istream& response) const override;
@@ -90,7 +93,17 @@ class WebDav : public CloudProvider {
                                     std::istream& response) const override;
   GeneralData getGeneralDataResponse(std::istream& response) const override;
 
-  IItem::Pointer toItem(const tinyxml2::XMLElement*) const;
+  /**
+   * Response element of a PROPFIND multistatus, with properties of its first
+   * propstat by local name.
+   */
+  struct Properties {
+    std::string href_;
+    std::unordered_map<std::string, std::string> values_;
+    bool collection_ = false;
+  };
+
+  IItem::Pointer toItem(const Properties&) const;
 
   bool reauthorize(int code,
                    const IHttpRequest::HeaderParameters&) const override;
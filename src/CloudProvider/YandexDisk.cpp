@@ -258,7 +258,7 @@ ICloudProvider::UploadFileRequest::Pointer YandexDisk::uploadFileAsync(
           f(item);
         },
         [=] { return std::make_shared<std::iostream>(wrapper.get()); },
-        std::make_shared<std::stringstream>(), nullptr,
+        std::make_shared<util::MemoryStream>(), nullptr,
         std::bind(&IUploadFileCallback::progress, callback.get(), _1, _2),
         true);
   };
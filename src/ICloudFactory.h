@@ -40,6 +40,11 @@ class CLOUDSTORAGE_API IThreadPoolFactory {
 
   virtual ~IThreadPoolFactory() = default;
   virtual IThreadPool::Pointer create(uint32_t requested_thread_count) = 0;
+
+  /**
+   * Creates a factory which makes thread pools of the given type.
+   */
+  static Pointer create(IThreadPool::Type = IThreadPool::Type::Default);
 };
 
 class CLOUDSTORAGE_API ICloudFactory {
@@ -56,6 +61,10 @@ class CLOUDSTORAGE_API ICloudFactory {
         const std::string& /* provider */, const std::string&) {}
     virtual void onCloudCreated(const std::shared_ptr<ICloudAccess>&) {}
     virtual void onCloudRemoved(const std::shared_ptr<ICloudAccess>&) {}
+    /**
+     * Called when events were added while there were none waiting to be
+     * processed; processEvents should be called soon after.
+     */
     virtual void onEventsAdded() {}
   };
 
@@ -88,6 +97,12 @@ class CLOUDSTORAGE_API ICloudFactory {
 
   virtual void processEvents() = 0;
 
+  /**
+   * Like processEvents, but returns once time_budget ran out, even when
+   * there are events left; onEventsAdded is called again in that case.
+   */
+  virtual void processEvents(std::chrono::milliseconds time_budget) = 0;
+
   virtual std::vector<std::string> availableProviders() const = 0;
   virtual std::vector<std::shared_ptr<ICloudAccess>> providers() const = 0;
 
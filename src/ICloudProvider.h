@@ -168,6 +168,34 @@ class CLOUDSTORAGE_API ICloudProvider {
      *  - success_page (page to be displayed when library was authorized
      *    successfully)
      *  - error_page (page to be displayed when library authorization failed)
+     *  - http_weight (share of the http engine given to this provider's
+     *    requests relative to other providers, defaults to 1)
+     *  - upload_chunk_size (size in bytes of a single chunk of a chunked
+     *    upload, rounded to what the provider accepts)
+     *  - upload_concurrency (count of chunks uploaded at once where the
+     *    provider permits it, defaults to 1; IUploadFileCallback::putData
+     *    is then called with out of order offsets)
+     *  - download_chunk_size (size in bytes of a single range of a parallel
+     *    download, defaults to 8 MiB)
+     *  - download_concurrency (count of ranges of a file downloaded at once,
+     *    defaults to 1 i.e. a single stream; data is still delivered to
+     *    IDownloadFileCallback::receivedData in order)
+     *  - recursive_concurrency (count of a directory's children visited at
+     *    once by operations which the provider does item by item, like
+     *    deleting a directory on hubic or copying the objects of a directory
+     *    moved on amazon s3, defaults to 4)
+     *  - item_data_ttl, item_url_ttl, directory_page_ttl (seconds for which
+     *    results of getItemDataAsync, getItemUrlAsync and
+     *    listDirectoryPageAsync are served from the provider's cache, default
+     *    to 0; with 0 results are cached only to be revalidated with
+     *    If-None-Match when the provider sent an ETag; the cache is
+     *    invalidated by mutations done through this provider only, a longer
+     *    ttl may serve stale data about changes made elsewhere)
+     *  - metadata_cache_size (count of cached results per operation, defaults
+     *    to 1024)
+     *  - multipart_uploads (used by amazon s3, unfinished multipart uploads
+     *    with their already uploaded parts; an upload of the same file to the
+     *    same key continues where the interrupted one stopped)
      */
     Hints hints_;
   };
@@ -312,6 +340,22 @@ class CLOUDSTORAGE_API ICloudProvider {
       IItem::Pointer parent, const std::string& filename,
       IUploadFileCallback::Pointer) = 0;
 
+  /**
+   * Uploads the file while it's being written, in parts which are sent as
+   * soon as the callback has their data.
+   *
+   * @param parent parent of the uploaded file
+   *
+   * @param filename name at which the uploaded file will be saved in cloud
+   * provider
+   *
+   * @return object representing the pending request, or nullptr if the
+   * provider can only upload files of known size
+   */
+  virtual UploadFileRequest::Pointer uploadFileStreamAsync(
+      IItem::Pointer parent, const std::string& filename,
+      IUploadStreamCallback::Pointer) = 0;
+
   /**
    * Retrieves IItem object from its id. That's the preferred way of updating
    * the IItem structure; IItem caches some data(e.g. thumbnail url or file url)
@@ -49,11 +49,14 @@ class CLOUDSTORAGE_API IHttpRequest {
     std::shared_ptr<std::ostream> error_stream_;
   };
 
+  enum class Priority { Normal, Background };
+
   static constexpr int Ok = 200;
   static constexpr int Accepted = 202;
   static constexpr int Partial = 206;
   static constexpr int MultiStatus = 207;
   static constexpr int PermamentRedirect = 301;
+  static constexpr int NotModified = 304;
   static constexpr int Bad = 400;
   static constexpr int Unauthorized = 401;
   static constexpr int Forbidden = 403;
@@ -120,6 +123,23 @@ class CLOUDSTORAGE_API IHttpRequest {
   virtual void setHeaderParameter(const std::string& parameter,
                                   const std::string& value) = 0;
 
+  /**
+   * Sets scheduling class of the request; when http engine limits count of
+   * running requests, queued requests with higher priority are started first.
+   *
+   * @param priority
+   */
+  virtual void setPriority(Priority) {}
+
+  /**
+   * Assigns the request to a queue; queued requests are started fairly across
+   * queues, proportionally to queue's weight.
+   *
+   * @param queue queue identifier, e.g. address of the cloud provider
+   * @param weight share of the http engine given to the queue
+   */
+  virtual void setQueue(uintptr_t /* queue */, uint32_t /* weight */) {}
+
   /**
    * Returns GET parameters set with setParameter.
    *
@@ -182,6 +202,36 @@ class CLOUDSTORAGE_API IHttp {
  public:
   using Pointer = std::unique_ptr<IHttp>;
 
+  struct Options {
+    /**
+     * Count of finished request handles kept around for reuse; reused
+     * handles keep their dns cache and tls sessions.
+     */
+    uint32_t handle_pool_size_ = 16;
+
+    /**
+     * Maximum count of idle connections kept open, shared by all requests.
+     */
+    uint32_t connection_cache_size_ = 32;
+
+    /**
+     * Negotiate http/2 and multiplex concurrent requests to the same host over
+     * a single connection.
+     */
+    bool http2_ = false;
+
+    /**
+     * Maximum count of running requests, 0 means no limit; requests over the
+     * limit are queued.
+     */
+    uint32_t max_requests_ = 0;
+
+    /**
+     * Maximum count of running requests to a single host, 0 means no limit.
+     */
+    uint32_t max_requests_per_host_ = 0;
+  };
+
   virtual ~IHttp() = default;
 
   /**
@@ -196,7 +246,18 @@ class CLOUDSTORAGE_API IHttp {
                                        const std::string& method = "GET",
                                        bool follow_redirect = true) const = 0;
 
+  /**
+   * Returns count of requests currently running over each open connection,
+   * only tracked when http/2 multiplexing is enabled.
+   *
+   * @return map from connection description to count of its streams
+   */
+  virtual std::unordered_map<std::string, uint32_t> streamCount() const {
+    return {};
+  }
+
   static IHttp::Pointer create();
+  static IHttp::Pointer create(const Options&);
 };
 
 }  // namespace cloudstorage
@@ -145,6 +145,14 @@ class IDownloadFileCallback : public IGenericCallback<EitherError<void>> {
    * @param now count of bytes downloaded
    */
   virtual void progress(uint64_t total, uint64_t now) = 0;
+
+  /**
+   * Background downloads, e.g. data read ahead of time, are started only when
+   * no other queued request can be.
+   *
+   * @return whether nobody waits for the data yet
+   */
+  virtual bool background() { return false; }
 };
 
 class IUploadFileCallback : public IGenericCallback<EitherError<IItem>> {
@@ -175,6 +183,36 @@ class IUploadFileCallback : public IGenericCallback<EitherError<IItem>> {
   virtual void progress(uint64_t total, uint64_t now) = 0;
 };
 
+/**
+ * Callback of an upload which starts while the file is still being written;
+ * size() returns IItem::UnknownSize until all of it was written.
+ */
+class IUploadStreamCallback : public IUploadFileCallback {
+ public:
+  using Pointer = std::shared_ptr<IUploadStreamCallback>;
+
+  /**
+   * Called before putData is asked for the data, ready should be called once
+   * length bytes from offset were written or the size is known, or with an
+   * error if the upload should be abandoned.
+   *
+   * @param offset byte offset of requested chunk
+   * @param length length of requested chunk
+   * @param ready may be called from any thread
+   */
+  virtual void waitForData(
+      uint64_t offset, uint64_t length,
+      std::function<void(EitherError<void>)> ready) = 0;
+
+  /**
+   * Called once the chunk was uploaded and won't be asked for again.
+   *
+   * @param offset byte offset of uploaded chunk
+   * @param length length of uploaded chunk
+   */
+  virtual void releaseData(uint64_t offset, uint64_t length) = 0;
+};
+
 struct Error {
   int code_;
   std::string description_;
@@ -217,6 +255,10 @@ class GenericCallback {
   GenericCallback() = default;
 
   GenericCallback(const GenericCallback& d) : functor_(d.functor_) {}
+  GenericCallback(GenericCallback&&) = default;
+
+  GenericCallback& operator=(const GenericCallback&) = default;
+  GenericCallback& operator=(GenericCallback&&) = default;
 
   template <class Function>
   GenericCallback(const Function& callback)
@@ -36,9 +36,17 @@ class CLOUDSTORAGE_API IThreadPool {
   using Pointer = std::unique_ptr<IThreadPool>;
   using Task = GenericCallback<>;
 
+  enum class Type {
+    // Workers share a single queue.
+    Default,
+    // Every worker has its own queue and idle workers steal from the others;
+    // scales better with many workers and many short tasks.
+    WorkStealing
+  };
+
   virtual ~IThreadPool() = default;
 
-  static Pointer create(uint32_t thread_count);
+  static Pointer create(uint32_t thread_count, Type type = Type::Default);
 
   virtual void schedule(const Task& f,
                         const std::chrono::system_clock::time_point& when =
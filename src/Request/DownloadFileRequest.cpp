@@ -23,6 +23,8 @@
 
 #include "DownloadFileRequest.h"
 
+#include <limits>
+
 #include "CloudProvider/CloudProvider.h"
 #include "Utility/Item.h"
 
@@ -50,6 +52,8 @@ void DownloadFileRequest::resolve(const Request::Pointer& request,
   send(
       [=](util::Output input) {
         auto request = request_factory(*file, *input);
+        if (request && callback->background())
+          request->setPriority(IHttpRequest::Priority::Background);
         if (range != FullRange)
           request->setHeaderParameter("Range", util::range_to_string(range));
         return request;
@@ -73,12 +77,122 @@ void DownloadFileRequest::resolve(const Request::Pointer& request,
           request->done(nullptr);
         }
       },
-      []() { return std::make_shared<std::stringstream>(); },
+      []() { return std::make_shared<util::MemoryStream>(); },
       std::make_shared<std::ostream>(&stream_wrapper_),
       std::bind(&DownloadFileRequest::ICallback::progress, callback, _1, _2),
       nullptr, true);
 }
 
+class ParallelDownloadFileRequest::ChunkCallback : public IDownloadFileCallback {
+ public:
+  ChunkCallback(Request::Pointer request, uint64_t index)
+      : request_(std::move(request)), index_(index) {}
+
+  void receivedData(const char* data, uint32_t length) override {
+    data_.append(data, length);
+    parent()->received(index_, data_.size());
+  }
+
+  void done(EitherError<void> e) override {
+    parent()->finished(request_, index_, e, std::move(data_));
+  }
+
+  void progress(uint64_t, uint64_t) override {}
+
+  bool background() override { return parent()->callback_->background(); }
+
+ private:
+  ParallelDownloadFileRequest* parent() const {
+    return static_cast<ParallelDownloadFileRequest*>(request_.get());
+  }
+
+  Request::Pointer request_;
+  uint64_t index_;
+  std::string data_;
+};
+
+ParallelDownloadFileRequest::ParallelDownloadFileRequest(
+    std::shared_ptr<CloudProvider> p, const IItem::Pointer& file,
+    const ICallback::Pointer& cb, Range range, uint64_t chunk_size,
+    uint32_t concurrency)
+    : Request(
+          std::move(p), [=](EitherError<void> e) { cb->done(e); },
+          std::bind(&ParallelDownloadFileRequest::resolve, this, _1)),
+      file_(file),
+      callback_(cb.get()),
+      range_(range),
+      chunk_size_(chunk_size),
+      concurrency_(concurrency),
+      chunk_count_((range.size_ + chunk_size - 1) / chunk_size),
+      next_(),
+      delivered_(),
+      received_(),
+      failed_() {}
+
+ParallelDownloadFileRequest::~ParallelDownloadFileRequest() { cancel(); }
+
+void ParallelDownloadFileRequest::resolve(const Request::Pointer& r) {
+  if (chunk_count_ == 0) return r->done(nullptr);
+  schedule(r);
+}
+
+void ParallelDownloadFileRequest::schedule(const Request::Pointer& r) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!failed_ && next_ < chunk_count_ &&
+         next_ < delivered_ + concurrency_) {
+    auto index = next_++;
+    auto start = range_.start_ + index * chunk_size_;
+    auto size = std::min(chunk_size_, range_.size_ - index * chunk_size_);
+    lock.unlock();
+    make_subrequest(&CloudProvider::downloadFileRangeAsync, file_,
+                    Range{start, size},
+                    std::make_shared<ChunkCallback>(r, index));
+    lock.lock();
+  }
+}
+
+void ParallelDownloadFileRequest::received(uint64_t index, uint64_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  progress_[index] = size;
+  auto now = received_;
+  for (const auto& p : progress_) now += p.second;
+  lock.unlock();
+  callback_->progress(range_.size_, now);
+}
+
+void ParallelDownloadFileRequest::finished(const Request::Pointer& r,
+                                           uint64_t index, EitherError<void> e,
+                                           std::string&& data) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  progress_.erase(index);
+  if (failed_) return;
+  if (e.left()) {
+    failed_ = true;
+    lock.unlock();
+    return r->done(e.left());
+  }
+  received_ += data.size();
+  chunks_[index] = std::move(data);
+  // Chunks are handed over while holding the lock, so that two threads
+  // finishing chunks at the same time can't reorder them.
+  for (auto it = chunks_.begin();
+       it != chunks_.end() && it->first == delivered_;
+       it = chunks_.erase(it), delivered_++) {
+    for (size_t offset = 0; offset < it->second.size();) {
+      auto length = static_cast<uint32_t>(std::min<size_t>(
+          it->second.size() - offset, std::numeric_limits<uint32_t>::max()));
+      callback_->receivedData(it->second.data() + offset, length);
+      offset += length;
+    }
+  }
+  bool done = delivered_ == chunk_count_;
+  lock.unlock();
+  if (done)
+    r->done(nullptr);
+  else
+    schedule(r);
+}
+
 DownloadStreamWrapper::DownloadStreamWrapper(
     std::function<void(const char*, uint32_t)> callback)
     : callback_(std::move(callback)) {}
@@ -131,7 +245,7 @@ void DownloadFileFromUrlRequest::resolve(const Pointer& r,
             r->done(nullptr);
           }
         },
-        [] { return std::make_shared<std::stringstream>(); },
+        [] { return std::make_shared<util::MemoryStream>(); },
         std::make_shared<std::ostream>(&stream_wrapper_),
         std::bind(&IDownloadFileCallback::progress, callback, _1, _2), nullptr,
         true);
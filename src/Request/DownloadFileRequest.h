@@ -24,6 +24,10 @@
 #ifndef DOWNLOADFILEREQUEST_H
 #define DOWNLOADFILEREQUEST_H
 
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
 #include "IItem.h"
 #include "Request.h"
 
@@ -72,6 +76,43 @@ class DownloadFileFromUrlRequest : public Request<EitherError<void>> {
   DownloadStreamWrapper stream_wrapper_;
 };
 
+// Downloads a range as several ranged downloads running concurrently and
+// passes their data to the callback in order. Chunks which arrive early wait
+// in memory, at most concurrency of them are fetched or buffered at once.
+class ParallelDownloadFileRequest : public Request<EitherError<void>> {
+ public:
+  using ICallback = IDownloadFileCallback;
+
+  ParallelDownloadFileRequest(std::shared_ptr<CloudProvider>,
+                              const IItem::Pointer& file,
+                              const ICallback::Pointer&, Range,
+                              uint64_t chunk_size, uint32_t concurrency);
+  ~ParallelDownloadFileRequest() override;
+
+ private:
+  class ChunkCallback;
+
+  void resolve(const Request::Pointer&);
+  void schedule(const Request::Pointer&);
+  void received(uint64_t index, uint64_t size);
+  void finished(const Request::Pointer&, uint64_t index, EitherError<void>,
+                std::string&& data);
+
+  IItem::Pointer file_;
+  ICallback* callback_;
+  Range range_;
+  uint64_t chunk_size_;
+  uint32_t concurrency_;
+  uint64_t chunk_count_;
+  std::mutex mutex_;
+  uint64_t next_;
+  uint64_t delivered_;
+  uint64_t received_;
+  bool failed_;
+  std::map<uint64_t, std::string> chunks_;
+  std::unordered_map<uint64_t, uint64_t> progress_;
+};
+
 }  // namespace cloudstorage
 
 #endif  // DOWNLOADFILEREQUEST_H
@@ -32,15 +32,34 @@ GetItemDataRequest::GetItemDataRequest(std::shared_ptr<CloudProvider> p,
                                        const std::string& id,
                                        const Callback& callback)
     : Request(std::move(p), callback, [=, this](Request::Pointer request) {
+        auto cache = provider()->metadata_cache();
+        auto generation = cache->generation();
+        auto cached = cache->itemData(id);
+        if (cached && cached->etag_.empty()) cached = nullptr;
         this->request(
             [=, this](util::Output input) {
-              return provider()->getItemDataRequest(id, *input);
+              auto r = provider()->getItemDataRequest(id, *input);
+              if (r && cached)
+                r->setHeaderParameter("If-None-Match", cached->etag_);
+              return r;
             },
             [=, this](EitherError<Response> r) {
               if (r.left()) return request->done(r.left());
+              if (cached &&
+                  r.right()->http_code() == IHttpRequest::NotModified) {
+                cache->putItemData(id, cached->value_, cached->etag_,
+                                   generation);
+                return request->done(cached->value_);
+              }
               try {
-                request->done(
-                    provider()->getItemDataResponse(r.right()->output()));
+                auto item =
+                    provider()->getItemDataResponse(r.right()->output());
+                auto etag = r.right()->headers().find("etag");
+                cache->putItemData(
+                    id, item,
+                    etag != r.right()->headers().end() ? etag->second : "",
+                    generation);
+                request->done(item);
               } catch (const std::exception& e) {
                 request->done(Error{IHttpRequest::Failure, e.what()});
               }
@@ -24,6 +24,7 @@
 #include "GetItemRequest.h"
 
 #include "CloudProvider/CloudProvider.h"
+#include "Utility/Item.h"
 
 namespace cloudstorage {
 
@@ -39,11 +40,12 @@ GetItemRequest::GetItemRequest(std::shared_ptr<CloudProvider> p,
 
 GetItemRequest::~GetItemRequest() { cancel(); }
 
-IItem::Pointer GetItemRequest::getItem(const IItem::List& items,
-                                       const std::string& name) const {
-  for (const IItem::Pointer& i : items)
-    if (i->filename() == name) return i;
-  return nullptr;
+IItem::Pointer GetItemRequest::getItem(
+    const MetadataCache::DirectoryIndex& index, const std::string& name) const {
+  auto it = index.value_.find(name);
+  return it != index.value_.end()
+             ? static_cast<const Item&>(*it->second).copy()
+             : nullptr;
 }
 
 void GetItemRequest::work(const IItem::Pointer& item, const std::string& p,
@@ -60,13 +62,18 @@ void GetItemRequest::work(const IItem::Pointer& item, const std::string& p,
               rest = it == std::string::npos
                          ? ""
                          : std::string(path.begin() + it, path.end());
+  auto cache = provider()->metadata_cache();
+  auto index = cache->directoryIndex(item->id());
+  if (index && index->fresh())
+    return work(getItem(*index, name), rest, complete);
+  auto generation = cache->generation();
   auto request = this->shared_from_this();
   make_subrequest(&CloudProvider::listDirectorySimpleAsync, item,
                   [=, this](EitherError<IItem::List> e) {
-                    if (e.left())
-                      request->done(e.left());
-                    else
-                      work(getItem(*e.right(), name), rest, complete);
+                    if (e.left()) return request->done(e.left());
+                    auto index = cache->putDirectoryIndex(
+                        item->id(), *e.right(), generation);
+                    work(getItem(*index, name), rest, complete);
                   });
 }
 
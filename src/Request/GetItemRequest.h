@@ -25,6 +25,7 @@
 #define GETITEMREQUEST_H
 
 #include "ListDirectoryRequest.h"
+#include "Utility/MetadataCache.h"
 
 namespace cloudstorage {
 
@@ -37,7 +38,7 @@ class GetItemRequest : public Request<EitherError<IItem>> {
   ~GetItemRequest() override;
 
  private:
-  IItem::Pointer getItem(const IItem::List& items,
+  IItem::Pointer getItem(const MetadataCache::DirectoryIndex&,
                          const std::string& name) const;
   void work(const IItem::Pointer& item, const std::string& path,
             const Callback&);
@@ -35,6 +35,7 @@ GetItemUrlRequest::GetItemUrlRequest(std::shared_ptr<CloudProvider> p,
                 if (item->type() == IItem::FileType::Directory)
                   return r->done(Error{IHttpRequest::ServiceUnavailable,
                                        util::Error::URL_UNAVAILABLE});
+                auto generation = provider()->metadata_cache()->generation();
                 auto is_implemented = std::make_shared<bool>();
                 r->request(
                     [=, this](util::Output input) {
@@ -60,6 +61,8 @@ GetItemUrlRequest::GetItemUrlRequest(std::shared_ptr<CloudProvider> p,
                           auto url = provider()->getItemUrlResponse(
                               *item, e.right()->headers(), e.right()->output());
                           static_cast<Item*>(item.get())->set_url(url);
+                          provider()->metadata_cache()->putItemUrl(
+                              item->id(), url, generation);
                           r->done(url);
                         }
                       } catch (const std::exception& e) {
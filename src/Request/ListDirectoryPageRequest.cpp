@@ -29,28 +29,59 @@ namespace cloudstorage {
 
 ListDirectoryPageRequest::ListDirectoryPageRequest(
     std::shared_ptr<CloudProvider> p, const IItem::Pointer& directory,
-    const std::string& token, const ListDirectoryPageCallback& completed)
+    const std::string& token, const ListDirectoryPageCallback& completed,
+    const std::function<void(IItem::Pointer)>& received)
     : Request(std::move(p), completed,
               [=](Request<EitherError<PageData>>::Pointer r) {
                 if (directory->type() != IItem::FileType::Directory)
                   return r->done(
                       Error{IHttpRequest::Bad, util::Error::NOT_A_DIRECTORY});
-                r->request(
-                    [=](util::Output input) {
-                      return r->provider()->listDirectoryRequest(*directory,
-                                                                 token, *input);
-                    },
-                    [=](EitherError<Response> e) {
-                      if (e.left()) return r->done(e.left());
-                      try {
-                        std::string next_token;
-                        auto lst = r->provider()->listDirectoryResponse(
-                            *directory, e.right()->output(), next_token);
-                        r->done(PageData{lst, next_token});
-                      } catch (const std::exception& e) {
-                        r->done(Error{IHttpRequest::Failure, e.what()});
-                      }
-                    });
+                auto cache = r->provider()->metadata_cache();
+                auto generation = cache->generation();
+                auto cached = cache->directoryPage(directory->id(), token);
+                if (cached && cached->etag_.empty()) cached = nullptr;
+                auto stream =
+                    r->provider()->listDirectoryStream(*directory, received);
+                auto factory = [=](util::Output input) {
+                  auto request = r->provider()->listDirectoryRequest(
+                      *directory, token, *input);
+                  if (request && cached)
+                    request->setHeaderParameter("If-None-Match",
+                                                cached->etag_);
+                  return request;
+                };
+                auto complete = [=](EitherError<Response> e) {
+                  if (e.left()) return r->done(e.left());
+                  if (cached &&
+                      e.right()->http_code() == IHttpRequest::NotModified) {
+                    cache->putDirectoryPage(directory->id(), token,
+                                            cached->value_, cached->etag_,
+                                            generation);
+                    return r->done(cached->value_);
+                  }
+                  try {
+                    std::string next_token;
+                    auto lst = stream ? stream->finish(next_token)
+                                      : r->provider()->listDirectoryResponse(
+                                            *directory, e.right()->output(),
+                                            next_token);
+                    auto etag = e.right()->headers().find("etag");
+                    PageData page{lst, next_token};
+                    cache->putDirectoryPage(
+                        directory->id(), token, page,
+                        etag != e.right()->headers().end() ? etag->second : "",
+                        generation);
+                    r->done(page);
+                  } catch (const std::exception& e) {
+                    r->done(Error{IHttpRequest::Failure, e.what()});
+                  }
+                };
+                if (stream)
+                  r->send(factory, complete,
+                          [] { return std::make_shared<util::MemoryStream>(); },
+                          stream, nullptr, nullptr, true);
+                else
+                  r->request(factory, complete);
               }) {}
 
 }  // namespace cloudstorage
@@ -30,9 +30,10 @@ namespace cloudstorage {
 
 class ListDirectoryPageRequest : public Request<EitherError<PageData>> {
  public:
-  ListDirectoryPageRequest(std::shared_ptr<CloudProvider>,
-                           const IItem::Pointer &, const std::string &,
-                           const ListDirectoryPageCallback &);
+  ListDirectoryPageRequest(
+      std::shared_ptr<CloudProvider>, const IItem::Pointer &,
+      const std::string &, const ListDirectoryPageCallback &,
+      const std::function<void(IItem::Pointer)> &received = nullptr);
 };
 
 }  // namespace cloudstorage
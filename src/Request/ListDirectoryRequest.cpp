@@ -23,6 +23,8 @@
 
 #include "ListDirectoryRequest.h"
 
+#include <algorithm>
+
 #include "CloudProvider/CloudProvider.h"
 
 using namespace std::placeholders;
@@ -51,13 +53,26 @@ void ListDirectoryRequest::resolve(const Request::Pointer& request,
 void ListDirectoryRequest::work(const IItem::Pointer& directory,
                                 std::string page_token, ICallback* callback) {
   auto request = this->shared_from_this();
+  std::weak_ptr<Request> weak = request;
+  auto streamed = std::make_shared<size_t>(0);
   request->make_subrequest(
-      &CloudProvider::listDirectoryPageAsync, directory, std::move(page_token),
+      &CloudProvider::streamDirectoryPageAsync, directory,
+      std::move(page_token),
+      [=, this](IItem::Pointer item) {
+        // The page may outlive this request if it's shared with others.
+        auto r = weak.lock();
+        if (!r || r->is_cancelled()) return;
+        callback->receivedItem(item);
+        result_.push_back(item);
+        (*streamed)++;
+      },
       [=, this](EitherError<PageData> e) {
         if (e.left()) return request->done(e.left());
-        for (auto& t : e.right()->items_) {
-          callback->receivedItem(t);
-          result_.push_back(t);
+        const auto& items = e.right()->items_;
+        for (auto i = std::min(*streamed, items.size()); i < items.size();
+             i++) {
+          callback->receivedItem(items[i]);
+          result_.push_back(items[i]);
         }
         if (!e.right()->next_token_.empty())
           work(directory, std::move(e.right()->next_token_), callback);
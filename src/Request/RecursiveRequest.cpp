@@ -32,44 +32,109 @@ RecursiveRequest<T>::RecursiveRequest(std::shared_ptr<CloudProvider> p,
                                       CompleteCallback callback,
                                       Visitor visitor)
     : Request<T>(p, callback, [=](typename Request<T>::Pointer r) {
-        visit(
-            r, item, [=](const T& e) { r->done(e); }, visitor);
+        auto traversal = std::make_shared<Traversal>();
+        traversal->visitor_ = visitor;
+        visit(r, traversal, item, [=](const T& e) { r->done(e); });
       }) {}
 
 template <class T>
 void RecursiveRequest<T>::visit(typename Request<T>::Pointer r,
-                                IItem::Pointer item, CompleteCallback callback,
-                                Visitor visitor) {
-  if (item->type() != IItem::FileType::Directory)
-    visitor(r, item, callback);
-  else
-    r->make_subrequest(&CloudProvider::listDirectorySimpleAsync, item,
-                       [=](EitherError<IItem::List> lst) {
-                         if (lst.left()) return callback(lst.left());
-                         visit(
-                             r, lst.right(),
-                             [=](const T& e) {
-                               if (e.left()) return callback(e);
-                               visitor(r, item, callback);
-                             },
-                             visitor);
-                       });
+                                std::shared_ptr<Traversal> traversal,
+                                IItem::Pointer item,
+                                CompleteCallback callback) {
+  if (item->type() != IItem::FileType::Directory) {
+    {
+      std::unique_lock<std::mutex> lock(traversal->mutex_);
+      traversal->pending_.emplace_back(item, callback);
+    }
+    return visitNext(r, traversal);
+  }
+  {
+    std::unique_lock<std::mutex> lock(traversal->mutex_);
+    if (!traversal->error_ && r->is_cancelled())
+      traversal->error_ = std::make_shared<Error>(
+          Error{IHttpRequest::Aborted, util::Error::ABORTED});
+    if (traversal->error_) {
+      auto error = traversal->error_;
+      lock.unlock();
+      return callback(error);
+    }
+  }
+  r->make_subrequest(
+      &CloudProvider::listDirectorySimpleAsync, item,
+      [=](EitherError<IItem::List> lst) {
+        if (lst.left()) return callback(lst.left());
+        visit(r, traversal, lst.right(), [=](const T& e) {
+          if (e.left()) return callback(e);
+          {
+            std::unique_lock<std::mutex> lock(traversal->mutex_);
+            traversal->pending_.emplace_back(item, callback);
+          }
+          visitNext(r, traversal);
+        });
+      });
 }
 
 template <class T>
 void RecursiveRequest<T>::visit(typename Request<T>::Pointer r,
+                                std::shared_ptr<Traversal> traversal,
                                 std::shared_ptr<IItem::List> lst,
-                                CompleteCallback callback, Visitor visitor) {
+                                CompleteCallback callback) {
   if (lst->empty()) return callback(T());
-  auto i = lst->back();
-  lst->pop_back();
-  visit(
-      r, i,
-      [=](const T& e) {
-        if (e.left()) return callback(e.left());
-        visit(r, lst, callback, visitor);
-      },
-      visitor);
+  auto directory = std::make_shared<Directory>();
+  directory->left_ = lst->size();
+  for (auto it = lst->rbegin(); it != lst->rend(); ++it)
+    visit(r, traversal, *it, [=](const T& e) {
+      std::unique_lock<std::mutex> lock(directory->mutex_);
+      if (e.left() && !directory->error_) {
+        directory->error_ = e.left();
+        std::unique_lock<std::mutex> lock(traversal->mutex_);
+        if (!traversal->error_) traversal->error_ = e.left();
+      }
+      if (--directory->left_ > 0) return;
+      auto error = directory->error_;
+      lock.unlock();
+      if (error)
+        callback(error);
+      else
+        callback(T());
+    });
+}
+
+template <class T>
+void RecursiveRequest<T>::visitNext(typename Request<T>::Pointer r,
+                                    std::shared_ptr<Traversal> traversal) {
+  std::unique_lock<std::mutex> lock(traversal->mutex_);
+  while (true) {
+    if (!traversal->error_ && r->is_cancelled())
+      traversal->error_ = std::make_shared<Error>(
+          Error{IHttpRequest::Aborted, util::Error::ABORTED});
+    if (traversal->pending_.empty() ||
+        (!traversal->error_ &&
+         traversal->running_ >= r->provider()->recursive_concurrency()))
+      return;
+    auto next = traversal->pending_.front();
+    traversal->pending_.pop_front();
+    if (traversal->error_) {
+      auto error = traversal->error_;
+      lock.unlock();
+      next.second(error);
+    } else {
+      traversal->running_++;
+      auto visitor = traversal->visitor_;
+      lock.unlock();
+      visitor(r, next.first, [=](const T& e) {
+        {
+          std::unique_lock<std::mutex> lock(traversal->mutex_);
+          traversal->running_--;
+          if (e.left() && !traversal->error_) traversal->error_ = e.left();
+        }
+        next.second(e);
+        visitNext(r, traversal);
+      });
+    }
+    lock.lock();
+  }
 }
 
 template class RecursiveRequest<EitherError<void>>;
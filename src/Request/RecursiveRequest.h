@@ -24,6 +24,8 @@
 #ifndef RECURSIVEREQUEST_H
 #define RECURSIVEREQUEST_H
 
+#include <deque>
+
 #include "Request.h"
 
 namespace cloudstorage {
@@ -39,11 +41,33 @@ class RecursiveRequest : public Request<ReturnValue> {
                    CompleteCallback, Visitor);
 
  private:
-  static void visit(typename Request<ReturnValue>::Pointer, IItem::Pointer item,
-                    CompleteCallback, Visitor);
+  // Visitor calls of the whole request share recursive_concurrency slots;
+  // listing directories and waiting for their children take none, so a
+  // directory never holds a slot its descendants need. The first error stops
+  // starting visitor calls, the queued ones complete with it.
+  struct Traversal {
+    std::mutex mutex_;
+    Visitor visitor_;
+    std::deque<std::pair<IItem::Pointer, CompleteCallback>> pending_;
+    uint32_t running_ = 0;
+    std::shared_ptr<Error> error_;
+  };
+
+  // Children of a directory which didn't complete yet.
+  struct Directory {
+    std::mutex mutex_;
+    size_t left_;
+    std::shared_ptr<Error> error_;
+  };
+
+  static void visit(typename Request<ReturnValue>::Pointer,
+                    std::shared_ptr<Traversal>, IItem::Pointer item,
+                    CompleteCallback);
   static void visit(typename Request<ReturnValue>::Pointer,
-                    std::shared_ptr<IItem::List> lst, CompleteCallback,
-                    Visitor);
+                    std::shared_ptr<Traversal>,
+                    std::shared_ptr<IItem::List> lst, CompleteCallback);
+  static void visitNext(typename Request<ReturnValue>::Pointer,
+                        std::shared_ptr<Traversal>);
 };
 
 }  // namespace cloudstorage
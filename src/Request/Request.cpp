@@ -56,12 +56,12 @@ const IHttpRequest::HeaderParameters& Response::headers() const {
   return http_.headers_;
 }
 
-std::stringstream& Response::output() {
-  return static_cast<std::stringstream&>(*http_.output_stream_.get());
+util::MemoryStream& Response::output() {
+  return static_cast<util::MemoryStream&>(*http_.output_stream_.get());
 }
 
-std::stringstream& Response::error_output() {
-  return static_cast<std::stringstream&>(*http_.error_stream_.get());
+util::MemoryStream& Response::error_output() {
+  return static_cast<util::MemoryStream&>(*http_.error_stream_.get());
 }
 
 template <class T>
@@ -269,26 +269,26 @@ template <class T>
 void Request<T>::request(const RequestFactory& factory,
                          const RequestCompleted& complete) {
   this->send(
-      factory, complete, [] { return std::make_shared<std::stringstream>(); },
-      std::make_shared<std::stringstream>(), nullptr, nullptr, true);
+      factory, complete, [] { return std::make_shared<util::MemoryStream>(); },
+      std::make_shared<util::MemoryStream>(), nullptr, nullptr, true);
 }
 
 template <class T>
 void Request<T>::send(const RequestFactory& factory,
                       const RequestCompleted& complete) {
   this->send(
-      factory, complete, [] { return std::make_shared<std::stringstream>(); },
-      std::make_shared<std::stringstream>(), nullptr, nullptr, false);
+      factory, complete, [] { return std::make_shared<util::MemoryStream>(); },
+      std::make_shared<util::MemoryStream>(), nullptr, nullptr, false);
 }
 
 template <class T>
 void Request<T>::query(const RequestFactory& factory,
                        const IHttpRequest::CompleteCallback& complete) {
-  auto input = std::make_shared<std::stringstream>();
+  auto input = std::make_shared<util::MemoryStream>();
   auto request = factory(input);
   this->send(request.get(), complete, input,
-             std::make_shared<std::stringstream>(),
-             std::make_shared<std::stringstream>(), nullptr, nullptr);
+             std::make_shared<util::MemoryStream>(),
+             std::make_shared<util::MemoryStream>(), nullptr, nullptr);
 }
 
 template <class T>
@@ -300,7 +300,7 @@ void Request<T>::send(const RequestFactory& factory,
                       const ProgressFunction& upload, bool authorized) {
   auto request = this->shared_from_this();
   auto input = input_factory();
-  auto error_stream = std::make_shared<std::stringstream>();
+  auto error_stream = std::make_shared<util::MemoryStream>();
   auto r = factory(input);
   if (authorized) authorize(r);
   send(
@@ -321,7 +321,7 @@ void Request<T>::send(const RequestFactory& factory,
                     Error{response.http_code_, error_stream->str()});
             }
             auto input = input_factory();
-            auto error_stream = std::make_shared<std::stringstream>();
+            auto error_stream = std::make_shared<util::MemoryStream>();
             auto r = factory(input);
             if (authorized) authorize(r);
             this->send(
@@ -351,10 +351,12 @@ void Request<T>::send(IHttpRequest* request,
                       const std::shared_ptr<std::ostream>& error,
                       const ProgressFunction& download,
                       const ProgressFunction& upload) {
-  if (request)
+  if (request) {
+    request->setQueue(reinterpret_cast<uintptr_t>(provider_.get()),
+                      provider_->http_weight());
     request->send(complete, input, output, error,
                   http_callback(download, upload));
-  else {
+  } else {
     *error << util::Error::UNIMPLEMENTED;
     complete({IHttpRequest::Aborted, {}, output, error});
   }
@@ -31,6 +31,7 @@
 
 #include "IHttp.h"
 #include "IRequest.h"
+#include "Utility/MemoryStream.h"
 #include "Utility/Utility.h"
 
 namespace cloudstorage {
@@ -45,8 +46,8 @@ class Response {
 
   int http_code() const;
   const IHttpRequest::HeaderParameters& headers() const;
-  std::stringstream& output();
-  std::stringstream& error_output();
+  util::MemoryStream& output();
+  util::MemoryStream& error_output();
 
  private:
   IHttpRequest::Response http_;
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * SingleFlightRequest.cpp
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "SingleFlightRequest.h"
+
+#include <algorithm>
+
+#include "CloudProvider/CloudProvider.h"
+
+namespace cloudstorage {
+
+template <class T>
+SingleFlightRequest<T>::SingleFlightRequest(
+    std::shared_ptr<CloudProvider> p, std::shared_ptr<Group> group,
+    const std::string& key, const Start& start,
+    const typename Request<T>::Callback& callback)
+    : Request<T>(std::move(p), callback,
+                 [=, this](typename Request<T>::Pointer) { attach(start); }),
+      group_(std::move(group)),
+      key_(key) {}
+
+template <class T>
+void SingleFlightRequest<T>::attach(const Start& start) {
+  std::unique_lock<std::mutex> lock(group_->mutex_);
+  auto it = group_->flights_.find(key_);
+  auto flight = it != group_->flights_.end() ? it->second.lock() : nullptr;
+  bool first = !flight;
+  if (first) {
+    flight = std::make_shared<Flight>();
+    group_->flights_[key_] = flight;
+  }
+  flight->waiters_.push_back(this);
+  flight_ = flight;
+  lock.unlock();
+  if (!first) return;
+  auto group = group_;
+  auto key = key_;
+  std::weak_ptr<Flight> weak = flight;
+  auto request = start([=](const T& result) {
+    SingleFlightRequest::finish(group, key, weak, result);
+  });
+  lock.lock();
+  // If the request already finished, or all waiters left before it was
+  // started, it is cancelled when going out of scope.
+  if (!flight->finished_) flight->request_ = std::move(request);
+  lock.unlock();
+}
+
+template <class T>
+void SingleFlightRequest<T>::finish(const std::shared_ptr<Group>& group,
+                                    const std::string& key,
+                                    const std::weak_ptr<Flight>& weak,
+                                    const T& result) {
+  std::vector<SingleFlightRequest*> waiters;
+  {
+    std::unique_lock<std::mutex> lock(group->mutex_);
+    auto flight = weak.lock();
+    if (!flight || flight->finished_) return;
+    flight->finished_ = true;
+    auto it = group->flights_.find(key);
+    if (it != group->flights_.end() && it->second.lock() == flight)
+      group->flights_.erase(it);
+    waiters = std::move(flight->waiters_);
+  }
+  // Waiters which are not in the list anymore are kept alive by their own
+  // cancel, which waits for done.
+  for (auto&& r : waiters) r->done(result);
+}
+
+template <class T>
+void SingleFlightRequest<T>::cancel() {
+  std::shared_ptr<IGenericRequest> request;
+  bool waiting = false;
+  if (flight_) {
+    std::unique_lock<std::mutex> lock(group_->mutex_);
+    auto& waiters = flight_->waiters_;
+    auto it = std::find(waiters.begin(), waiters.end(), this);
+    if (it != waiters.end()) {
+      waiters.erase(it);
+      waiting = true;
+      if (waiters.empty() && !flight_->finished_) {
+        flight_->finished_ = true;
+        auto flight = group_->flights_.find(key_);
+        if (flight != group_->flights_.end() &&
+            flight->second.lock() == flight_)
+          group_->flights_.erase(flight);
+        request = std::move(flight_->request_);
+      }
+    }
+  }
+  if (request) request->cancel();
+  if (waiting) this->done(Error{IHttpRequest::Aborted, util::Error::ABORTED});
+  Request<T>::cancel();
+}
+
+template class SingleFlightRequest<EitherError<IItem>>;
+template class SingleFlightRequest<EitherError<std::string>>;
+template class SingleFlightRequest<EitherError<PageData>>;
+
+}  // namespace cloudstorage
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * SingleFlightRequest.h
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SINGLEFLIGHTREQUEST_H
+#define SINGLEFLIGHTREQUEST_H
+
+#include <unordered_map>
+
+#include "Request.h"
+
+namespace cloudstorage {
+
+// Attaches to an in-flight request started for the same key instead of
+// starting a new one. The result is delivered to every attached request;
+// the shared request is cancelled only when all of them are cancelled.
+template <class T>
+class SingleFlightRequest : public Request<T> {
+ public:
+  using Start = std::function<std::shared_ptr<IGenericRequest>(
+      const typename Request<T>::Callback&)>;
+
+  class Flight;
+
+  class Group {
+   private:
+    friend class SingleFlightRequest;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::weak_ptr<Flight>> flights_;
+  };
+
+  SingleFlightRequest(std::shared_ptr<CloudProvider>,
+                      std::shared_ptr<Group> group, const std::string& key,
+                      const Start& start,
+                      const typename Request<T>::Callback&);
+
+  void cancel() override;
+
+ private:
+  void attach(const Start& start);
+  static void finish(const std::shared_ptr<Group>& group,
+                     const std::string& key,
+                     const std::weak_ptr<Flight>& flight, const T& result);
+
+  std::shared_ptr<Group> group_;
+  std::string key_;
+  std::shared_ptr<Flight> flight_;
+};
+
+template <class T>
+class SingleFlightRequest<T>::Flight {
+ private:
+  friend class SingleFlightRequest;
+
+  std::shared_ptr<IGenericRequest> request_;
+  std::vector<SingleFlightRequest*> waiters_;
+  bool finished_ = false;
+};
+
+}  // namespace cloudstorage
+
+#endif  // SINGLEFLIGHTREQUEST_H
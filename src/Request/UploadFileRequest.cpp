@@ -25,6 +25,8 @@
 
 #include "CloudProvider/CloudProvider.h"
 
+#include <algorithm>
+
 using namespace std::placeholders;
 
 namespace cloudstorage {
@@ -64,7 +66,7 @@ void UploadFileRequest::resolve(
         }
       },
       [=] { return std::make_shared<std::iostream>(stream_wrapper.get()); },
-      std::make_shared<std::stringstream>(), nullptr,
+      std::make_shared<util::MemoryStream>(), nullptr,
       std::bind(&UploadFileRequest::ICallback::progress, callback, _1, _2),
       true);
 }
@@ -116,4 +118,50 @@ std::streambuf::int_type UploadStreamWrapper::underflow() {
                            : std::char_traits<char>::to_int_type(*gptr());
 }
 
+UploadChunkStreamWrapper::UploadChunkStreamWrapper(
+    std::function<uint32_t(char*, uint32_t, uint64_t)> callback,
+    uint64_t offset, uint64_t length)
+    : buffer_(new char[BUFFER_SIZE]),
+      callback_(std::move(callback)),
+      offset_(offset),
+      length_(length),
+      read_(),
+      position_() {}
+
+void UploadChunkStreamWrapper::reset() {
+  read_ = 0;
+  setg(nullptr, nullptr, nullptr);
+}
+
+UploadChunkStreamWrapper::pos_type UploadChunkStreamWrapper::seekoff(
+    off_type off, std::ios_base::seekdir way, std::ios_base::openmode) {
+  if (off != 0) return {off_type(-1)};
+  if (way == std::ios_base::beg) {
+    reset();
+    return position_ = 0;
+  } else if (way == std::ios_base::end) {
+    return position_ = length_;
+  } else {
+    return position_;
+  }
+}
+
+UploadChunkStreamWrapper::pos_type UploadChunkStreamWrapper::seekpos(
+    pos_type position, std::ios_base::openmode which) {
+  return seekoff(off_type(position), std::ios_base::beg, which);
+}
+
+std::streambuf::int_type UploadChunkStreamWrapper::underflow() {
+  if (gptr() == egptr() && read_ < length_) {
+    auto size = callback_(
+        buffer_.get(),
+        static_cast<uint32_t>(std::min<uint64_t>(BUFFER_SIZE, length_ - read_)),
+        offset_ + read_);
+    read_ += size;
+    setg(buffer_.get(), buffer_.get(), buffer_.get() + size);
+  }
+  return gptr() == egptr() ? std::char_traits<char>::eof()
+                           : std::char_traits<char>::to_int_type(*gptr());
+}
+
 }  // namespace cloudstorage
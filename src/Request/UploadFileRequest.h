@@ -53,6 +53,31 @@ class UploadStreamWrapper : public std::streambuf {
   pos_type position_;
 };
 
+// Streams a window of the upload, reading it from the callback on demand.
+class UploadChunkStreamWrapper : public std::streambuf {
+ public:
+  using Pointer = std::shared_ptr<UploadChunkStreamWrapper>;
+
+  static constexpr uint32_t BUFFER_SIZE = 64 * 1024;
+
+  UploadChunkStreamWrapper(
+      std::function<uint32_t(char*, uint32_t, uint64_t)> callback,
+      uint64_t offset, uint64_t length);
+  void reset();
+
+  pos_type seekoff(off_type, std::ios_base::seekdir,
+                   std::ios_base::openmode) override;
+  pos_type seekpos(pos_type, std::ios_base::openmode) override;
+  int_type underflow() override;
+
+  std::unique_ptr<char[]> buffer_;
+  std::function<uint32_t(char*, uint32_t, uint64_t)> callback_;
+  uint64_t offset_;
+  uint64_t length_;
+  uint64_t read_;
+  pos_type position_;
+};
+
 class UploadFileRequest : public Request<EitherError<IItem>> {
  public:
   using ICallback = IUploadFileCallback;
@@ -22,6 +22,8 @@
  *****************************************************************************/
 #include "CloudEventLoop.h"
 
+#include <utility>
+
 #include "Utility/Utility.h"
 
 namespace cloudstorage {
@@ -40,10 +42,51 @@ void CloudEventLoop::onEventAdded() {
   if (callback_) callback_->onEventsAdded();
 }
 
-void CloudEventLoop::processEvents() { impl_->process_events(); }
+void CloudEventLoop::processEvents(priv::LoopImpl::Deadline deadline) {
+  impl_->process_events(deadline);
+}
 
 namespace priv {
 
+EventQueue::EventQueue() : head_(nullptr), batch_(nullptr) {}
+
+EventQueue::~EventQueue() {
+  release(head_.load());
+  release(batch_);
+}
+
+bool EventQueue::push(std::function<void()> &&event) {
+  auto node = new Node{std::move(event), head_.load(std::memory_order_relaxed)};
+  while (!head_.compare_exchange_weak(node->next_, node)) {
+  }
+  return node->next_ == nullptr;
+}
+
+bool EventQueue::pop(std::function<void()> &event) {
+  if (!batch_) {
+    auto node = head_.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+      auto next = node->next_;
+      node->next_ = batch_;
+      batch_ = node;
+      node = next;
+    }
+  }
+  if (!batch_) return false;
+  std::unique_ptr<Node> node(batch_);
+  batch_ = node->next_;
+  event = std::move(node->event_);
+  return true;
+}
+
+bool EventQueue::pushed() const { return head_.load() != nullptr; }
+
+bool EventQueue::empty() const { return !batch_ && !pushed(); }
+
+void EventQueue::release(Node *node) {
+  while (node) delete std::exchange(node, node->next_);
+}
+
 LoopImpl::LoopImpl(IThreadPoolFactory *factory, CloudEventLoop *loop)
     : cancellation_thread_pool_(factory->create(1)),
       interrupt_(std::make_shared<std::atomic_bool>(false)),
@@ -98,11 +141,7 @@ void LoopImpl::cancel(uintptr_t tag) {
 }
 
 void LoopImpl::invoke(std::function<void()> &&f) {
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    events_.emplace_back(std::move(f));
-  }
-  event_loop_->onEventAdded();
+  if (events_.push(std::move(f))) event_loop_->onEventAdded();
 }
 
 #ifdef WITH_THUMBNAILER
@@ -121,14 +160,25 @@ std::shared_ptr<IThreadPool> LoopImpl::thumbnailer_thread_pool() const {
 }
 #endif
 
-void LoopImpl::process_events() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  for (const auto &e : events_) {
-    lock.unlock();
-    e();
-    lock.lock();
-  }
-  events_.clear();
+void LoopImpl::process_events(Deadline deadline) {
+  do {
+    // Events may process events recursively; when another thread is
+    // processing them already, it picks up what was added meanwhile.
+    std::unique_lock<std::recursive_mutex> lock(process_mutex_,
+                                                std::try_to_lock);
+    if (!lock) return;
+    std::function<void()> event;
+    while (events_.pop(event)) {
+      event();
+      if (deadline != Deadline::max() &&
+          std::chrono::steady_clock::now() >= deadline) {
+        if (events_.empty()) return;
+        lock.unlock();
+        event_loop_->onEventAdded();
+        return;
+      }
+    }
+  } while (events_.pushed());
 }
 
 void LoopImpl::clear() {
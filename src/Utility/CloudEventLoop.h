@@ -24,7 +24,9 @@
 #define CLOUDEVENTLOOP_H
 
 #include <atomic>
-#include <list>
+#include <chrono>
+#include <functional>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include "ICloudFactory.h"
@@ -51,6 +53,37 @@ class CloudEventLoop;
 
 namespace priv {
 
+// Lock free queue of events; any thread may push, events are taken out in
+// batches by the thread processing them.
+class EventQueue {
+ public:
+  EventQueue();
+  ~EventQueue();
+
+  // Returns true when there were no pushed events which weren't taken yet.
+  bool push(std::function<void()>&&);
+
+  // Takes the oldest event; only one thread at a time may call it.
+  bool pop(std::function<void()>&);
+
+  // Whether there are pushed events which pop didn't take in its batch yet.
+  bool pushed() const;
+
+  // Whether pop would return false; only for the thread calling pop.
+  bool empty() const;
+
+ private:
+  struct Node {
+    std::function<void()> event_;
+    Node* next_;
+  };
+
+  static void release(Node*);
+
+  std::atomic<Node*> head_;
+  Node* batch_;
+};
+
 class LoopImpl {
  public:
   LoopImpl(IThreadPoolFactory* factory, CloudEventLoop*);
@@ -68,12 +101,15 @@ class LoopImpl {
   void clear();
   std::shared_ptr<std::atomic_bool> interrupt() const { return interrupt_; }
 
-  void process_events();
+  using Deadline = std::chrono::steady_clock::time_point;
+
+  void process_events(Deadline = Deadline::max());
 
  private:
   std::mutex mutex_;
+  std::recursive_mutex process_mutex_;
   std::unordered_map<uint64_t, std::shared_ptr<IGenericRequest>> pending_;
-  std::list<std::function<void()>> events_;
+  EventQueue events_;
 #ifdef WITH_THUMBNAILER
   std::mutex thumbnailer_mutex_;
   std::shared_ptr<IThreadPool> thumbnailer_thread_pool_;
@@ -94,7 +130,8 @@ class CloudEventLoop {
   std::shared_ptr<priv::LoopImpl> impl() { return impl_; }
 
   void onEventAdded();
-  void processEvents();
+  void processEvents(
+      priv::LoopImpl::Deadline = priv::LoopImpl::Deadline::max());
 
  private:
   std::shared_ptr<ICloudFactory::ICallback> callback_;
@@ -43,6 +43,10 @@ struct HttpWrapper : public IHttp {
     return http_->create(url, method, follow_redirect);
   }
 
+  std::unordered_map<std::string, uint32_t> streamCount() const override {
+    return http_->streamCount();
+  }
+
   std::shared_ptr<IHttp> http_;
 };
 
@@ -501,6 +505,10 @@ bool CloudFactory::loadConfig(std::istream& stream) {
 
 void CloudFactory::processEvents() { event_loop_->processEvents(); }
 
+void CloudFactory::processEvents(std::chrono::milliseconds time_budget) {
+  event_loop_->processEvents(std::chrono::steady_clock::now() + time_budget);
+}
+
 int CloudFactory::exec() {
   std::unique_lock<std::mutex> lock(mutex_);
   static std::atomic_bool interrupt;
@@ -556,15 +564,23 @@ std::unique_ptr<ICloudFactory> ICloudFactory::create(
   init_data.http_ = IHttp::create();
   init_data.http_server_factory_ = IHttpServerFactory::create();
   init_data.crypto_ = ICrypto::create();
+  init_data.thread_pool_factory_ = IThreadPoolFactory::create();
+  init_data.callback_ = std::move(callback);
+  init_data.provider_init_data_ = std::move(provider_init_data);
+  return create(std::move(init_data));
+}
+
+IThreadPoolFactory::Pointer IThreadPoolFactory::create(IThreadPool::Type type) {
   struct ThreadPoolFactory : public IThreadPoolFactory {
+    ThreadPoolFactory(IThreadPool::Type type) : type_(type) {}
+
     IThreadPool::Pointer create(uint32_t size) override {
-      return IThreadPool::create(size);
+      return IThreadPool::create(size, type_);
     }
+
+    IThreadPool::Type type_;
   };
-  init_data.thread_pool_factory_ = util::make_unique<ThreadPoolFactory>();
-  init_data.callback_ = std::move(callback);
-  init_data.provider_init_data_ = std::move(provider_init_data);
-  return create(std::move(init_data));
+  return util::make_unique<ThreadPoolFactory>(type);
 }
 
 std::unique_ptr<ICloudFactory> ICloudFactory::create(InitData&& d) {
@@ -72,6 +72,7 @@ class CloudFactory : public ICloudFactory {
   bool loadConfig(std::istream&& stream) override;
 
   void processEvents() override;
+  void processEvents(std::chrono::milliseconds time_budget) override;
 
   int exec() override;
   void quit() override;
@@ -44,6 +44,74 @@ namespace cloudstorage {
 
 namespace {
 
+class InvalidatingUploadCallback : public IUploadFileCallback {
+ public:
+  InvalidatingUploadCallback(IUploadFileCallback::Pointer callback,
+                             std::function<void(EitherError<IItem>)> done)
+      : callback_(std::move(callback)), done_(std::move(done)) {}
+
+  uint32_t putData(char* data, uint32_t maxlength, uint64_t offset) override {
+    return callback_->putData(data, maxlength, offset);
+  }
+
+  uint64_t size() override { return callback_->size(); }
+
+  void progress(uint64_t total, uint64_t now) override {
+    callback_->progress(total, now);
+  }
+
+  void done(EitherError<IItem> e) override {
+    done_(e);
+    callback_->done(e);
+  }
+
+ private:
+  IUploadFileCallback::Pointer callback_;
+  std::function<void(EitherError<IItem>)> done_;
+};
+
+class InvalidatingUploadStreamCallback : public IUploadStreamCallback {
+ public:
+  InvalidatingUploadStreamCallback(
+      IUploadStreamCallback::Pointer callback,
+      std::function<void(EitherError<IItem>)> done)
+      : callback_(std::move(callback)), done_(std::move(done)) {}
+
+  void waitForData(uint64_t offset, uint64_t length,
+                   std::function<void(EitherError<void>)> ready) override {
+    callback_->waitForData(offset, length, std::move(ready));
+  }
+
+  void releaseData(uint64_t offset, uint64_t length) override {
+    callback_->releaseData(offset, length);
+  }
+
+  uint32_t putData(char* data, uint32_t maxlength, uint64_t offset) override {
+    return callback_->putData(data, maxlength, offset);
+  }
+
+  uint64_t size() override { return callback_->size(); }
+
+  void progress(uint64_t total, uint64_t now) override {
+    callback_->progress(total, now);
+  }
+
+  void done(EitherError<IItem> e) override {
+    done_(e);
+    callback_->done(e);
+  }
+
+ private:
+  IUploadStreamCallback::Pointer callback_;
+  std::function<void(EitherError<IItem>)> done_;
+};
+
+void uploaded(MetadataCache* cache, const IItem& parent,
+              const EitherError<IItem>& e) {
+  cache->invalidateDirectory(parent.id());
+  if (e.right()) cache->invalidate(*e.right());
+}
+
 class CloudProviderWrapper : public ICloudProvider {
  public:
   CloudProviderWrapper(std::shared_ptr<CloudProvider> p) : p_(std::move(p)) {}
@@ -98,13 +166,31 @@ class CloudProviderWrapper : public ICloudProvider {
   DownloadFileRequest::Pointer downloadFileAsync(
       IItem::Pointer item, IDownloadFileCallback::Pointer cb,
       Range range) override {
-    return p_->downloadFileAsync(item, cb, range);
+    return p_->downloadFileParallelAsync(item, cb, range);
   }
 
   UploadFileRequest::Pointer uploadFileAsync(
       IItem::Pointer parent, const std::string& filename,
       IUploadFileCallback::Pointer cb) override {
-    return p_->uploadFileAsync(parent, filename, cb);
+    auto p = p_;
+    return p_->uploadFileAsync(
+        parent, filename,
+        std::make_shared<InvalidatingUploadCallback>(
+            cb, [=](EitherError<IItem> e) {
+              uploaded(p->metadata_cache(), *parent, e);
+            }));
+  }
+
+  UploadFileRequest::Pointer uploadFileStreamAsync(
+      IItem::Pointer parent, const std::string& filename,
+      IUploadStreamCallback::Pointer cb) override {
+    auto p = p_;
+    return p_->uploadFileStreamAsync(
+        parent, filename,
+        std::make_shared<InvalidatingUploadStreamCallback>(
+            cb, [=](EitherError<IItem> e) {
+              uploaded(p->metadata_cache(), *parent, e);
+            }));
   }
 
   GetItemDataRequest::Pointer getItemDataAsync(
@@ -119,25 +205,44 @@ class CloudProviderWrapper : public ICloudProvider {
 
   DeleteItemRequest::Pointer deleteItemAsync(
       IItem::Pointer item, DeleteItemCallback callback) override {
-    return p_->deleteItemAsync(item, callback);
+    auto p = p_;
+    return p_->deleteItemAsync(item, [=](EitherError<void> e) {
+      p->metadata_cache()->invalidate(*item);
+      callback(e);
+    });
   }
 
   CreateDirectoryRequest::Pointer createDirectoryAsync(
       IItem::Pointer parent, const std::string& name,
       CreateDirectoryCallback callback) override {
-    return p_->createDirectoryAsync(parent, name, callback);
+    auto p = p_;
+    return p_->createDirectoryAsync(
+        parent, name, [=](EitherError<IItem> e) {
+          p->metadata_cache()->invalidateDirectory(parent->id());
+          callback(e);
+        });
   }
 
   MoveItemRequest::Pointer moveItemAsync(IItem::Pointer source,
                                          IItem::Pointer destination,
                                          MoveItemCallback callback) override {
-    return p_->moveItemAsync(source, destination, callback);
+    auto p = p_;
+    return p_->moveItemAsync(
+        source, destination, [=](EitherError<IItem> e) {
+          p->metadata_cache()->invalidate(*source);
+          p->metadata_cache()->invalidateDirectory(destination->id());
+          callback(e);
+        });
   }
 
   RenameItemRequest::Pointer renameItemAsync(
       IItem::Pointer item, const std::string& name,
       RenameItemCallback callback) override {
-    return p_->renameItemAsync(item, name, callback);
+    auto p = p_;
+    return p_->renameItemAsync(item, name, [=](EitherError<IItem> e) {
+      p->metadata_cache()->invalidate(*item);
+      callback(e);
+    });
   }
 
   ListDirectoryPageRequest::Pointer listDirectoryPageAsync(
@@ -166,7 +271,12 @@ class CloudProviderWrapper : public ICloudProvider {
   UploadFileRequest::Pointer uploadFileAsync(
       IItem::Pointer parent, const std::string& path,
       const std::string& filename, UploadFileCallback callback) override {
-    return p_->uploadFileAsync(parent, path, filename, callback);
+    auto p = p_;
+    return p_->uploadFileAsync(parent, path, filename,
+                               [=](EitherError<IItem> e) {
+                                 uploaded(p->metadata_cache(), *parent, e);
+                                 callback(e);
+                               });
   }
 
   GeneralDataRequest::Pointer getGeneralDataAsync(
@@ -25,7 +25,9 @@
 
 #include "CurlHttp.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstring>
 #include <sstream>
 
@@ -38,11 +40,21 @@
 
 const uint32_t MAX_URL_LENGTH = 1024;
 const uint32_t POLL_TIMEOUT = 100;
+const uint64_t QUEUE_STRIDE = 1 << 20;
+
+// curl_multi_poll and curl_multi_wakeup were added in curl 7.68.0.
+#define CURL_WAKEUP_VERSION 0x074400
+// CURLINFO_CONN_ID was added in curl 8.2.0.
+#define CURL_CONN_ID_VERSION 0x080200
 
 namespace cloudstorage {
 
 IHttp::Pointer IHttp::create() { return util::make_unique<curl::CurlHttp>(); }
 
+IHttp::Pointer IHttp::create(const Options& options) {
+  return util::make_unique<curl::CurlHttp>(options);
+}
+
 namespace curl {
 
 namespace {
@@ -121,6 +133,32 @@ int progress_callback(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
   return 0;
 }
 
+void share_lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+  static_cast<std::mutex*>(userptr)[data].lock();
+}
+
+void share_unlock(CURL*, curl_lock_data data, void* userptr) {
+  static_cast<std::mutex*>(userptr)[data].unlock();
+}
+
+std::string host(const std::string& url) {
+  auto scheme = url.find("://");
+  auto path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+  return url.substr(0, path);
+}
+
+std::string connection_key(CURL* handle) {
+  char* effective_url = nullptr;
+  curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &effective_url);
+  std::string result = host(effective_url ? effective_url : "");
+#if LIBCURL_VERSION_NUM >= CURL_CONN_ID_VERSION
+  curl_off_t connection_id = -1;
+  curl_easy_getinfo(handle, CURLINFO_CONN_ID, &connection_id);
+  if (connection_id >= 0) result += "#" + std::to_string(connection_id);
+#endif
+  return result;
+}
+
 std::ios::pos_type stream_length(std::istream& data) {
   data.seekg(0, data.end);
   std::ios::pos_type length = data.tellg();
@@ -130,58 +168,214 @@ std::ios::pos_type stream_length(std::istream& data) {
 
 }  // namespace
 
-CurlHttp::Worker::Worker() : done_(), thread_(std::bind(&Worker::work, this)) {}
+CurlHttp::Worker::Worker(const Options& options)
+    : done_(),
+      queued_count_(),
+      pass_(),
+      options_(options),
+      multi_(curl_multi_init()),
+      share_(curl_share_init()) {
+  curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS,
+                    static_cast<long>(options_.connection_cache_size_));
+  if (options_.http2_)
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, share_lock);
+  curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, share_unlock);
+  curl_share_setopt(share_, CURLSHOPT_USERDATA, share_lock_.data());
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  thread_ = std::thread(std::bind(&Worker::work, this));
+}
 
 CurlHttp::Worker::~Worker() {
-  done_ = true;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    done_ = true;
+  }
   nonempty_.notify_one();
+#if LIBCURL_VERSION_NUM >= CURL_WAKEUP_VERSION
+  curl_multi_wakeup(multi_);
+#endif
   thread_.join();
+  curl_multi_cleanup(multi_);
+  requests_.clear();
+  handle_pool_.clear();
+  curl_share_cleanup(share_);
 }
 
 void CurlHttp::Worker::work() {
   util::set_thread_name("cs-curl");
   util::attach_thread();
-  auto handle = curl_multi_init();
-  while (!done_ || !pending_.empty()) {
+  while (!done_ || !pending_.empty() || queued_count_ > 0) {
     std::unique_lock<std::mutex> lock(lock_);
-    nonempty_.wait(lock, [this] {
-      return done_ || !requests_.empty() || !pending_.empty();
-    });
+    if (pending_.empty() && queued_count_ == 0)
+      nonempty_.wait(lock, [this] { return done_ || !requests_.empty(); });
     auto requests = util::exchange(requests_, {});
     lock.unlock();
-    for (auto&& r : requests) {
-      curl_multi_add_handle(handle, r->handle_.get());
-      pending_[r->handle_.get()] = std::move(r);
-    }
-    int rc;
-    curl_multi_wait(handle, nullptr, 0, POLL_TIMEOUT, &rc);
-    if (rc == 0)
-      std::this_thread::sleep_for(std::chrono::milliseconds(POLL_TIMEOUT));
+    for (auto&& r : requests) enqueue(std::move(r));
+    start();
     int running_handles = 0;
-    curl_multi_perform(handle, &running_handles);
+    curl_multi_perform(multi_, &running_handles);
+    bool finished = false;
     CURLMsg* msg;
     do {
       int message_count;
-      msg = curl_multi_info_read(handle, &message_count);
+      msg = curl_multi_info_read(multi_, &message_count);
       if (msg && msg->msg == CURLMSG_DONE) {
         auto easy_handle = msg->easy_handle;
-        curl_multi_remove_handle(handle, easy_handle);
+        curl_multi_remove_handle(multi_, easy_handle);
         auto it = pending_.find(easy_handle);
+        auto host_it = running_per_host_.find(it->second->host_);
+        if (--host_it->second == 0) running_per_host_.erase(host_it);
         it->second->done(msg->data.result);
+        release(std::move(it->second->handle_));
         pending_.erase(it);
+        finished = true;
       }
     } while (msg);
+    if (options_.http2_) updateStreamCount();
+    if (!pending_.empty() && !(finished && queued_count_ > 0)) wait();
   }
-  curl_multi_cleanup(handle);
   util::detach_thread();
 }
 
+void CurlHttp::Worker::wait() {
+  // Sleeps until socket activity, the next curl timeout or add() waking us up;
+  // POLL_TIMEOUT only bounds how late abort and pause requests are noticed.
+#if LIBCURL_VERSION_NUM >= CURL_WAKEUP_VERSION
+  curl_multi_poll(multi_, nullptr, 0, POLL_TIMEOUT, nullptr);
+#else
+  long timeout = -1;
+  curl_multi_timeout(multi_, &timeout);
+  if (timeout < 0 || timeout > static_cast<long>(POLL_TIMEOUT))
+    timeout = POLL_TIMEOUT;
+  // curl_multi_wait returns at once when there is nothing to wait on; only
+  // then sleep for what is left of the timeout.
+  auto start = std::chrono::steady_clock::now();
+  int numfds = 0;
+  curl_multi_wait(multi_, nullptr, 0, static_cast<int>(timeout), &numfds);
+  auto remaining = std::chrono::milliseconds(timeout) -
+                   (std::chrono::steady_clock::now() - start);
+  if (numfds == 0 && remaining > std::chrono::milliseconds(0))
+    std::this_thread::sleep_for(remaining);
+#endif
+}
+
 void CurlHttp::Worker::add(RequestData::Pointer r) {
   {
     std::lock_guard<std::mutex> lock(lock_);
     requests_.push_back(std::move(r));
   }
-  nonempty_.notify_all();
+  nonempty_.notify_one();
+#if LIBCURL_VERSION_NUM >= CURL_WAKEUP_VERSION
+  curl_multi_wakeup(multi_);
+#endif
+}
+
+void CurlHttp::Worker::enqueue(RequestData::Pointer r) {
+  auto& queue = queues_[static_cast<int>(r->priority_)][r->queue_];
+  if (queue.requests_.empty()) queue.pass_ = std::max(queue.pass_, pass_);
+  queue.requests_.push_back(std::move(r));
+  queued_count_++;
+}
+
+void CurlHttp::Worker::start() {
+  reap();
+  while (queued_count_ > 0 &&
+         (options_.max_requests_ == 0 ||
+          pending_.size() < options_.max_requests_) &&
+         startNext()) {
+  }
+}
+
+bool CurlHttp::Worker::startNext() {
+  // Strict priority between classes, stride scheduling between queues of the
+  // same class: every started request advances its queue's pass by
+  // QUEUE_STRIDE / weight and the queue with the lowest pass goes next.
+  for (auto& queues : queues_) {
+    Queue* next_queue = nullptr;
+    std::deque<RequestData::Pointer>::iterator next;
+    for (auto& q : queues) {
+      if (next_queue && next_queue->pass_ <= q.second.pass_) continue;
+      auto& requests = q.second.requests_;
+      for (auto it = requests.begin(); it != requests.end(); it++)
+        if (available((*it)->host_)) {
+          next_queue = &q.second;
+          next = it;
+          break;
+        }
+    }
+    for (auto it = queues.begin(); it != queues.end();)
+      if (it->second.requests_.empty() && &it->second != next_queue)
+        it = queues.erase(it);
+      else
+        it++;
+    if (next_queue) {
+      auto r = std::move(*next);
+      next_queue->requests_.erase(next);
+      queued_count_--;
+      pass_ = next_queue->pass_;
+      next_queue->pass_ += QUEUE_STRIDE / std::max<uint32_t>(r->weight_, 1);
+      running_per_host_[r->host_]++;
+      curl_multi_add_handle(multi_, r->handle_.get());
+      pending_[r->handle_.get()] = std::move(r);
+      return true;
+    }
+  }
+  return false;
+}
+
+void CurlHttp::Worker::reap() {
+  // Aborted requests don't wait for a free slot.
+  for (auto& queues : queues_)
+    for (auto& q : queues) {
+      auto& requests = q.second.requests_;
+      for (auto it = requests.begin(); it != requests.end();)
+        if ((*it)->callback_ && (*it)->callback_->abort()) {
+          (*it)->done(CURLE_ABORTED_BY_CALLBACK);
+          release(std::move((*it)->handle_));
+          it = requests.erase(it);
+          queued_count_--;
+        } else {
+          it++;
+        }
+    }
+}
+
+bool CurlHttp::Worker::available(const std::string& host) const {
+  if (options_.max_requests_per_host_ == 0) return true;
+  auto it = running_per_host_.find(host);
+  return it == running_per_host_.end() ||
+         it->second < options_.max_requests_per_host_;
+}
+
+std::unique_ptr<CURL, CurlDeleter> CurlHttp::Worker::acquire() {
+  std::unique_ptr<CURL, CurlDeleter> handle;
+  {
+    std::lock_guard<std::mutex> lock(handle_pool_lock_);
+    if (!handle_pool_.empty()) {
+      handle = std::move(handle_pool_.back());
+      handle_pool_.pop_back();
+    }
+  }
+  if (!handle) handle.reset(curl_easy_init());
+  curl_easy_setopt(handle.get(), CURLOPT_SHARE, share_);
+  return handle;
+}
+
+void CurlHttp::Worker::release(std::unique_ptr<CURL, CurlDeleter> handle) {
+  curl_easy_reset(handle.get());
+  std::lock_guard<std::mutex> lock(handle_pool_lock_);
+  if (handle_pool_.size() < options_.handle_pool_size_)
+    handle_pool_.push_back(std::move(handle));
+}
+
+void CurlHttp::Worker::updateStreamCount() {
+  std::unordered_map<std::string, uint32_t> stream_count;
+  for (const auto& r : pending_) stream_count[connection_key(r.first)]++;
+  std::lock_guard<std::mutex> lock(stream_count_lock_);
+  stream_count_ = std::move(stream_count);
 }
 
 void RequestData::done(int code) {
@@ -209,10 +403,13 @@ CurlHttpRequest::CurlHttpRequest(std::string url, std::string method,
     : url_(std::move(url)),
       method_(std::move(method)),
       follow_redirect_(follow_redirect),
+      priority_(Priority::Normal),
+      queue_(),
+      weight_(1),
       worker_(std::move(worker)) {}
 
 std::unique_ptr<CURL, CurlDeleter> CurlHttpRequest::init() const {
-  std::unique_ptr<CURL, CurlDeleter> handle(curl_easy_init());
+  auto handle = worker_->acquire();
   curl_easy_setopt(handle.get(), CURLOPT_WRITEFUNCTION, write_callback);
   curl_easy_setopt(handle.get(), CURLOPT_READFUNCTION, read_callback);
   curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, header_callback);
@@ -222,6 +419,11 @@ std::unique_ptr<CURL, CurlDeleter> CurlHttpRequest::init() const {
                    static_cast<long>(follow_redirect_));
   curl_easy_setopt(handle.get(), CURLOPT_XFERINFOFUNCTION, progress_callback);
   curl_easy_setopt(handle.get(), CURLOPT_NOPROGRESS, static_cast<long>(false));
+  if (worker_->options_.http2_) {
+    curl_easy_setopt(handle.get(), CURLOPT_HTTP_VERSION,
+                     static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    curl_easy_setopt(handle.get(), CURLOPT_PIPEWAIT, static_cast<long>(true));
+  }
   std::string parameters = parametersToString();
   std::string url = url_ + (!parameters.empty() ? ("?" + parameters) : "");
   curl_easy_setopt(handle.get(), CURLOPT_URL, url.c_str());
@@ -253,6 +455,13 @@ const std::string& CurlHttpRequest::url() const { return url_; }
 
 const std::string& CurlHttpRequest::method() const { return method_; }
 
+void CurlHttpRequest::setPriority(Priority priority) { priority_ = priority; }
+
+void CurlHttpRequest::setQueue(uintptr_t queue, uint32_t weight) {
+  queue_ = queue;
+  weight_ = weight;
+}
+
 RequestData::Pointer CurlHttpRequest::prepare(
     const CompleteCallback& complete, const std::shared_ptr<std::istream>& data,
     std::shared_ptr<std::ostream> response,
@@ -270,7 +479,11 @@ RequestData::Pointer CurlHttpRequest::prepare(
                                                  complete,
                                                  follow_redirect(),
                                                  0,
-                                                 0});
+                                                 0,
+                                                 host(url_),
+                                                 priority_,
+                                                 queue_,
+                                                 weight_});
   auto handle = cb_data->handle_.get();
   curl_easy_setopt(handle, CURLOPT_WRITEDATA, cb_data.get());
   curl_easy_setopt(handle, CURLOPT_XFERINFODATA, cb_data.get());
@@ -333,7 +546,8 @@ void CurlListDeleter::operator()(curl_slist* lst) const {
   curl_slist_free_all(lst);
 }
 
-CurlHttp::CurlHttp() : worker_(std::make_shared<Worker>()) {}
+CurlHttp::CurlHttp(const Options& options)
+    : worker_(std::make_shared<Worker>(options)) {}
 
 IHttpRequest::Pointer CurlHttp::create(const std::string& url,
                                        const std::string& method,
@@ -342,6 +556,11 @@ IHttpRequest::Pointer CurlHttp::create(const std::string& url,
                                             worker_);
 }
 
+std::unordered_map<std::string, uint32_t> CurlHttp::streamCount() const {
+  std::lock_guard<std::mutex> lock(worker_->stream_count_lock_);
+  return worker_->stream_count_;
+}
+
 }  // namespace curl
 
 }  // namespace cloudstorage
@@ -352,6 +571,7 @@ IHttpRequest::Pointer CurlHttp::create(const std::string& url,
 
 namespace cloudstorage {
 IHttp::Pointer IHttp::create() { return nullptr; }
+IHttp::Pointer IHttp::create(const Options&) { return nullptr; }
 }  // namespace cloudstorage
 
 #endif  // WITH_CURL
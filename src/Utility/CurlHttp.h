@@ -27,9 +27,11 @@
 #ifdef WITH_CURL
 
 #include <curl/curl.h>
+#include <array>
 #include <atomic>
 #include <cctype>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <string>
 #include <thread>
@@ -65,32 +67,67 @@ struct RequestData {
   bool follow_redirect_;
   long http_code_;
   uint64_t received_bytes_;
+  std::string host_;
+  IHttpRequest::Priority priority_;
+  uintptr_t queue_;
+  uint32_t weight_;
 
   void done(int result);
 };
 
 class CurlHttp : public IHttp {
  public:
-  CurlHttp();
+  CurlHttp(const Options& = {});
 
   IHttpRequest::Pointer create(const std::string&, const std::string&,
                                bool) const override;
+  std::unordered_map<std::string, uint32_t> streamCount() const override;
 
  private:
   friend class CurlHttpRequest;
 
   struct Worker {
-    Worker();
+    static constexpr int PRIORITY_COUNT = 2;
+
+    struct Queue {
+      uint64_t pass_;
+      std::deque<RequestData::Pointer> requests_;
+    };
+
+    Worker(const Options&);
     ~Worker();
 
     void work();
+    void wait();
     void add(RequestData::Pointer r);
 
+    void enqueue(RequestData::Pointer r);
+    void start();
+    void reap();
+    bool startNext();
+    bool available(const std::string& host) const;
+
+    std::unique_ptr<CURL, CurlDeleter> acquire();
+    void release(std::unique_ptr<CURL, CurlDeleter>);
+    void updateStreamCount();
+
     std::atomic_bool done_;
     std::condition_variable nonempty_;
     std::vector<RequestData::Pointer> requests_;
     std::unordered_map<CURL*, RequestData::Pointer> pending_;
+    std::array<std::unordered_map<uintptr_t, Queue>, PRIORITY_COUNT> queues_;
+    std::unordered_map<std::string, uint32_t> running_per_host_;
+    size_t queued_count_;
+    uint64_t pass_;
     std::mutex lock_;
+    Options options_;
+    CURLM* multi_;
+    CURLSH* share_;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> share_lock_;
+    std::mutex handle_pool_lock_;
+    std::vector<std::unique_ptr<CURL, CurlDeleter>> handle_pool_;
+    mutable std::mutex stream_count_lock_;
+    std::unordered_map<std::string, uint32_t> stream_count_;
     std::thread thread_;
   };
 
@@ -116,6 +153,9 @@ class CurlHttpRequest : public IHttpRequest,
   const std::string& method() const override;
   bool follow_redirect() const override;
 
+  void setPriority(Priority) override;
+  void setQueue(uintptr_t queue, uint32_t weight) override;
+
   RequestData::Pointer prepare(const CompleteCallback&,
                                const std::shared_ptr<std::istream>& data,
                                std::shared_ptr<std::ostream> response,
@@ -137,6 +177,9 @@ class CurlHttpRequest : public IHttpRequest,
   HeaderParameters header_parameters_;
   std::string method_;
   bool follow_redirect_;
+  Priority priority_;
+  uintptr_t queue_;
+  uint32_t weight_;
   std::shared_ptr<CurlHttp::Worker> worker_;
 };
 
@@ -112,6 +112,17 @@ std::string Item::toString() const {
   return util::json::to_string(json);
 }
 
+Item::Pointer Item::copy() const {
+  auto item = std::make_shared<Item>(filename(), id(), size(), timestamp(),
+                                     type());
+  item->set_thumbnail_url(thumbnail_url());
+  item->set_hidden(is_hidden());
+  item->set_url(url());
+  item->set_mime_type(mime_type());
+  item->set_parents(parents());
+  return item;
+}
+
 IItem::Pointer IItem::fromString(const std::string& str) {
   Json::Value json = util::json::from_string(str);
   auto item = util::make_unique<Item>(
@@ -51,6 +51,12 @@ class CLOUDSTORAGE_API Item : public IItem {
 
   std::string toString() const override;
 
+  /**
+   * Independent copy of the item, safe to modify while the original is
+   * shared, e.g. by a cache.
+   */
+  Item::Pointer copy() const;
+
   std::string url() const;
   void set_url(std::string);
 
@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * MemoryStream.cpp : pooled in-memory stream implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "MemoryStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+namespace cloudstorage {
+namespace util {
+
+namespace {
+
+class Pool {
+ public:
+  std::vector<char> acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (storage_.empty()) return {};
+    auto result = std::move(storage_.back());
+    storage_.pop_back();
+    return result;
+  }
+
+  void release(std::vector<char>&& storage) {
+    if (storage.empty() ||
+        storage.size() > MemoryBuffer::MAX_POOLED_CAPACITY)
+      return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (storage_.size() < MemoryBuffer::MAX_POOLED_COUNT)
+      storage_.push_back(std::move(storage));
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::vector<char>> storage_;
+};
+
+Pool& pool() {
+  // Never destroyed, buffers may still be released during static destruction.
+  static auto instance = new Pool;
+  return *instance;
+}
+
+}  // namespace
+
+MemoryBuffer::MemoryBuffer() : storage_(pool().acquire()), end_() {
+  setg(storage_.data(), storage_.data(), storage_.data());
+  setp(storage_.data(), storage_.data() + storage_.size());
+}
+
+MemoryBuffer::~MemoryBuffer() { pool().release(std::move(storage_)); }
+
+std::string_view MemoryBuffer::view() const {
+  if (!gptr()) return {};
+  return std::string_view(gptr(), end() - (gptr() - storage_.data()));
+}
+
+std::string_view MemoryBuffer::contents() const {
+  return std::string_view(storage_.data(), end());
+}
+
+size_t MemoryBuffer::end() const {
+  return std::max(end_, static_cast<size_t>(pptr() - storage_.data()));
+}
+
+void MemoryBuffer::reserve(size_t size) {
+  if (size <= storage_.size()) return;
+  auto get = gptr() - storage_.data();
+  auto put = pptr() - storage_.data();
+  end_ = end();
+  storage_.resize(std::max({size, 2 * storage_.size(), MIN_CAPACITY}));
+  setg(storage_.data(), storage_.data() + get, storage_.data() + end_);
+  setp(storage_.data() + put, storage_.data() + storage_.size());
+}
+
+MemoryBuffer::int_type MemoryBuffer::underflow() {
+  end_ = end();
+  setg(storage_.data(), gptr(), storage_.data() + end_);
+  return gptr() == egptr() ? traits_type::eof()
+                           : traits_type::to_int_type(*gptr());
+}
+
+MemoryBuffer::int_type MemoryBuffer::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  reserve(pptr() - storage_.data() + 1);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+std::streamsize MemoryBuffer::xsputn(const char* data, std::streamsize size) {
+  if (size <= 0) return 0;
+  reserve(pptr() - storage_.data() + size);
+  std::memcpy(pptr(), data, size);
+  setp(pptr() + size, storage_.data() + storage_.size());
+  return size;
+}
+
+MemoryBuffer::pos_type MemoryBuffer::seekoff(off_type off,
+                                             std::ios_base::seekdir way,
+                                             std::ios_base::openmode which) {
+  bool in = which & std::ios_base::in, out = which & std::ios_base::out;
+  end_ = end();
+  off_type base;
+  if (way == std::ios_base::beg)
+    base = 0;
+  else if (way == std::ios_base::end)
+    base = end_;
+  else if (in && !out)
+    base = gptr() - storage_.data();
+  else if (out && !in)
+    base = pptr() - storage_.data();
+  else
+    return pos_type(off_type(-1));
+  off_type position = base + off;
+  if (position < 0 || position > static_cast<off_type>(end_))
+    return pos_type(off_type(-1));
+  if (in)
+    setg(storage_.data(), storage_.data() + position, storage_.data() + end_);
+  if (out)
+    setp(storage_.data() + position, storage_.data() + storage_.size());
+  return pos_type(position);
+}
+
+MemoryBuffer::pos_type MemoryBuffer::seekpos(pos_type position,
+                                             std::ios_base::openmode which) {
+  return seekoff(off_type(position), std::ios_base::beg, which);
+}
+
+MemoryStream::MemoryStream() : std::iostream(nullptr) { init(&buffer_); }
+
+MemoryBuffer* MemoryStream::rdbuf() { return &buffer_; }
+
+std::string_view MemoryStream::view() const { return buffer_.view(); }
+
+std::string MemoryStream::str() const {
+  return std::string(buffer_.contents());
+}
+
+std::string_view view(std::istream& stream, std::string& storage) {
+  if (auto buffer = dynamic_cast<MemoryBuffer*>(stream.rdbuf()))
+    return buffer->view();
+  std::stringstream sstream;
+  sstream << stream.rdbuf();
+  storage = sstream.str();
+  return storage;
+}
+
+}  // namespace util
+}  // namespace cloudstorage
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * MemoryStream.h : pooled in-memory stream
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef MEMORYSTREAM_H
+#define MEMORYSTREAM_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cloudstorage {
+namespace util {
+
+// Contiguous growable byte buffer. Storage is taken from and returned to a
+// process wide pool, so short lived request bodies and responses don't hit
+// the allocator every time.
+class MemoryBuffer : public std::streambuf {
+ public:
+  static constexpr size_t MIN_CAPACITY = 4096;
+  static constexpr size_t MAX_POOLED_CAPACITY = 4 * 1024 * 1024;
+  static constexpr size_t MAX_POOLED_COUNT = 32;
+
+  MemoryBuffer();
+  ~MemoryBuffer() override;
+
+  MemoryBuffer(const MemoryBuffer&) = delete;
+  MemoryBuffer& operator=(const MemoryBuffer&) = delete;
+
+  // Bytes which weren't read yet.
+  std::string_view view() const;
+  // Everything written so far, regardless of the read position.
+  std::string_view contents() const;
+
+ protected:
+  int_type underflow() override;
+  int_type overflow(int_type) override;
+  std::streamsize xsputn(const char*, std::streamsize) override;
+  pos_type seekoff(off_type, std::ios_base::seekdir,
+                   std::ios_base::openmode) override;
+  pos_type seekpos(pos_type, std::ios_base::openmode) override;
+
+ private:
+  size_t end() const;
+  void reserve(size_t);
+
+  std::vector<char> storage_;
+  size_t end_;
+};
+
+class MemoryStream : public std::iostream {
+ public:
+  MemoryStream();
+
+  MemoryBuffer* rdbuf();
+
+  std::string_view view() const;
+  std::string str() const;
+
+ private:
+  MemoryBuffer buffer_;
+};
+
+// Unread contents of the stream; when the stream isn't backed by
+// MemoryBuffer its contents are read into storage.
+std::string_view view(std::istream&, std::string& storage);
+
+}  // namespace util
+}  // namespace cloudstorage
+
+#endif  // MEMORYSTREAM_H
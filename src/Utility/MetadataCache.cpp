@@ -0,0 +1,215 @@
+/*****************************************************************************
+ * MetadataCache.cpp
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "MetadataCache.h"
+
+#include <algorithm>
+
+#include "Utility/Item.h"
+
+namespace cloudstorage {
+
+namespace {
+
+std::string page_key(const std::string& id, const std::string& token) {
+  return id + "\n" + token;
+}
+
+bool is_page_of(const std::string& key, const std::string& id) {
+  return key.size() > id.size() && key[id.size()] == '\n' &&
+         key.compare(0, id.size(), id) == 0;
+}
+
+bool starts_with(const std::string& key, const std::string& prefix) {
+  return key.compare(0, prefix.size(), prefix) == 0;
+}
+
+IItem::Pointer copy(const IItem::Pointer& item) {
+  return item ? static_cast<const Item&>(*item).copy() : nullptr;
+}
+
+PageData copy(const PageData& page) {
+  PageData result{{}, page.next_token_};
+  for (const auto& item : page.items_) result.items_.push_back(copy(item));
+  return result;
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache(size_t size)
+    : generation_(),
+      item_data_ttl_(),
+      item_url_ttl_(),
+      directory_page_ttl_(),
+      item_data_(size),
+      item_url_(size),
+      directory_page_(size),
+      directory_index_(size) {}
+
+void MetadataCache::set_item_data_ttl(std::chrono::seconds ttl) {
+  item_data_ttl_ = ttl.count();
+}
+
+void MetadataCache::set_item_url_ttl(std::chrono::seconds ttl) {
+  item_url_ttl_ = ttl.count();
+}
+
+void MetadataCache::set_directory_page_ttl(std::chrono::seconds ttl) {
+  directory_page_ttl_ = ttl.count();
+}
+
+uint64_t MetadataCache::generation() const { return generation_; }
+
+template <class T>
+std::shared_ptr<T> MetadataCache::get(util::LRUCache<std::string, T>& cache,
+                                      const std::string& key) {
+  auto entry = cache.get(key);
+  if (entry && !entry->fresh() && entry->etag_.empty()) {
+    cache.erase(key);
+    return nullptr;
+  }
+  return entry;
+}
+
+std::shared_ptr<MetadataCache::ItemData> MetadataCache::itemData(
+    const std::string& id) {
+  auto entry = get(item_data_, id);
+  if (!entry) return nullptr;
+  return std::make_shared<ItemData>(
+      ItemData{copy(entry->value_), entry->etag_, entry->expires_});
+}
+
+void MetadataCache::putItemData(const std::string& id, IItem::Pointer item,
+                                const std::string& etag, uint64_t generation) {
+  auto ttl = std::chrono::seconds(item_data_ttl_);
+  if (ttl.count() <= 0 && etag.empty()) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation != generation_) return;
+  item_data_.put(id, std::make_shared<ItemData>(
+                         ItemData{copy(item), etag, Clock::now() + ttl}));
+}
+
+std::shared_ptr<MetadataCache::ItemUrl> MetadataCache::itemUrl(
+    const std::string& id) {
+  return get(item_url_, id);
+}
+
+void MetadataCache::putItemUrl(const std::string& id, const std::string& url,
+                               uint64_t generation) {
+  auto ttl = std::chrono::seconds(item_url_ttl_);
+  if (ttl.count() <= 0) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation != generation_) return;
+  item_url_.put(
+      id, std::make_shared<ItemUrl>(ItemUrl{url, "", Clock::now() + ttl}));
+}
+
+std::shared_ptr<MetadataCache::DirectoryPage> MetadataCache::directoryPage(
+    const std::string& id, const std::string& token) {
+  auto entry = get(directory_page_, page_key(id, token));
+  if (!entry) return nullptr;
+  return std::make_shared<DirectoryPage>(
+      DirectoryPage{copy(entry->value_), entry->etag_, entry->expires_});
+}
+
+void MetadataCache::putDirectoryPage(const std::string& id,
+                                     const std::string& token,
+                                     const PageData& page,
+                                     const std::string& etag,
+                                     uint64_t generation) {
+  auto ttl = std::chrono::seconds(directory_page_ttl_);
+  if (ttl.count() <= 0 && etag.empty()) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation != generation_) return;
+  directory_page_.put(page_key(id, token),
+                      std::make_shared<DirectoryPage>(
+                          DirectoryPage{copy(page), etag, Clock::now() + ttl}));
+}
+
+std::shared_ptr<MetadataCache::DirectoryIndex> MetadataCache::directoryIndex(
+    const std::string& id) {
+  return get(directory_index_, id);
+}
+
+std::shared_ptr<MetadataCache::DirectoryIndex>
+MetadataCache::putDirectoryIndex(const std::string& id,
+                                 const IItem::List& items,
+                                 uint64_t generation) {
+  auto ttl = std::chrono::seconds(directory_page_ttl_);
+  auto index = std::make_shared<DirectoryIndex>();
+  for (const auto& item : items)
+    index->value_.emplace(item->filename(), copy(item));
+  index->expires_ = Clock::now() + ttl;
+  if (ttl.count() <= 0) return index;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation == generation_) directory_index_.put(id, index);
+  return index;
+}
+
+void MetadataCache::invalidate(const IItem& item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  generation_++;
+  auto id = item.id();
+  const auto& parents = static_cast<const Item&>(item).parents();
+  // Providers addressing items by path give a directory's descendants ids
+  // starting with its own; they are gone or moved along with it.
+  auto descendant = [&](const std::string& key) {
+    return item.type() == IItem::FileType::Directory && starts_with(key, id);
+  };
+  item_data_.erase(id);
+  item_url_.erase(id);
+  item_data_.erase_if(
+      [&](const std::string& key, const ItemData&) { return descendant(key); });
+  item_url_.erase_if(
+      [&](const std::string& key, const ItemUrl&) { return descendant(key); });
+  directory_page_.erase_if([&](const std::string& key,
+                               const DirectoryPage& page) {
+    if (is_page_of(key, id) || descendant(key)) return true;
+    for (const auto& parent : parents)
+      if (is_page_of(key, parent)) return true;
+    return std::any_of(
+        page.value_.items_.begin(), page.value_.items_.end(),
+        [&](const IItem::Pointer& child) { return child->id() == id; });
+  });
+  directory_index_.erase(id);
+  for (const auto& parent : parents) directory_index_.erase(parent);
+  directory_index_.erase_if([&](const std::string& key,
+                                const DirectoryIndex& index) {
+    if (descendant(key)) return true;
+    return std::any_of(index.value_.begin(), index.value_.end(),
+                       [&](const std::pair<const std::string, IItem::Pointer>&
+                               child) { return child.second->id() == id; });
+  });
+}
+
+void MetadataCache::invalidateDirectory(const std::string& id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  generation_++;
+  item_data_.erase(id);
+  directory_page_.erase_if([&](const std::string& key, const DirectoryPage&) {
+    return is_page_of(key, id);
+  });
+  directory_index_.erase(id);
+}
+
+}  // namespace cloudstorage
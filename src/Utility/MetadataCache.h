@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * MetadataCache.h
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "IRequest.h"
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+
+// Caches results of getItemDataAsync, getItemUrlAsync and
+// listDirectoryPageAsync, and full directory listings indexed by filename for
+// path resolution. Entries are fresh for their operation's ttl; stale entries
+// which came with an ETag are kept so that they can be revalidated with
+// If-None-Match. Items are copied on the way in and out of item data and page
+// entries, callers are free to modify what they get.
+class MetadataCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  template <class T>
+  struct Entry {
+    T value_;
+    std::string etag_;
+    Clock::time_point expires_;
+
+    bool fresh() const { return Clock::now() < expires_; }
+  };
+
+  using ItemData = Entry<IItem::Pointer>;
+  using ItemUrl = Entry<std::string>;
+  using DirectoryPage = Entry<PageData>;
+  using DirectoryIndex =
+      Entry<std::unordered_map<std::string, IItem::Pointer>>;
+
+  MetadataCache(size_t size = 1024);
+
+  void set_item_data_ttl(std::chrono::seconds);
+  void set_item_url_ttl(std::chrono::seconds);
+  void set_directory_page_ttl(std::chrono::seconds);
+
+  /**
+   * Incremented on every invalidation; results of requests started with an
+   * older generation are not cached.
+   */
+  uint64_t generation() const;
+
+  std::shared_ptr<ItemData> itemData(const std::string& id);
+  void putItemData(const std::string& id, IItem::Pointer,
+                   const std::string& etag, uint64_t generation);
+
+  std::shared_ptr<ItemUrl> itemUrl(const std::string& id);
+  void putItemUrl(const std::string& id, const std::string& url,
+                  uint64_t generation);
+
+  std::shared_ptr<DirectoryPage> directoryPage(const std::string& id,
+                                               const std::string& token);
+  void putDirectoryPage(const std::string& id, const std::string& token,
+                        const PageData&, const std::string& etag,
+                        uint64_t generation);
+
+  /**
+   * Children of the directory by filename, fresh for directory_page_ttl.
+   * The items are shared with the cache, copy them before handing them out.
+   */
+  std::shared_ptr<DirectoryIndex> directoryIndex(const std::string& id);
+
+  /**
+   * Indexes the listing; it is cached unless caching is disabled or the
+   * cache was invalidated since the listing started.
+   */
+  std::shared_ptr<DirectoryIndex> putDirectoryIndex(const std::string& id,
+                                                    const IItem::List&,
+                                                    uint64_t generation);
+
+  /**
+   * Drops everything known about the item: its data, url, listing and every
+   * cached page it appears in; for a directory also every entry whose key
+   * starts with its id.
+   */
+  void invalidate(const IItem&);
+
+  /**
+   * Drops the directory's data and listing, used when its children change.
+   */
+  void invalidateDirectory(const std::string& id);
+
+ private:
+  template <class T>
+  std::shared_ptr<T> get(util::LRUCache<std::string, T>&,
+                         const std::string& key);
+
+  std::mutex mutex_;
+  std::atomic<uint64_t> generation_;
+  std::atomic<int64_t> item_data_ttl_;
+  std::atomic<int64_t> item_url_ttl_;
+  std::atomic<int64_t> directory_page_ttl_;
+  util::LRUCache<std::string, ItemData> item_data_;
+  util::LRUCache<std::string, ItemUrl> item_url_;
+  util::LRUCache<std::string, DirectoryPage> directory_page_;
+  util::LRUCache<std::string, DirectoryIndex> directory_index_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // METADATACACHE_H
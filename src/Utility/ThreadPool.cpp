@@ -25,11 +25,13 @@
 #include <algorithm>
 
 #include "Utility/Utility.h"
+#include "Utility/WorkStealingThreadPool.h"
 
 namespace cloudstorage {
 
 ThreadPool::ThreadPool(uint32_t thread_count)
-    : destroyed_(false),
+    : delayed_task_sequence_(),
+      destroyed_(false),
       delayed_tasks_thread_(std::bind(&ThreadPool::handleDelayedTasks, this)) {
   for (uint32_t i = 0; i < thread_count; ++i) {
     workers_.emplace_back([this]() {
@@ -46,7 +48,7 @@ ThreadPool::ThreadPool(uint32_t thread_count)
             worker_cv_.wait(lock);
           }
           if (!tasks_.empty()) {
-            task = tasks_.front();
+            task = std::move(tasks_.front());
             tasks_.pop_front();
           } else {
             break;
@@ -62,54 +64,62 @@ ThreadPool::ThreadPool(uint32_t thread_count)
 ThreadPool::~ThreadPool() {
   std::unique_lock<std::mutex> lock(mutex_);
   destroyed_ = true;
+  // Delayed tasks which didn't fire yet are run right away by the workers.
+  while (!delayed_tasks_.empty()) {
+    tasks_.emplace_back(delayed_tasks_.top().task_);
+    delayed_tasks_.pop();
+  }
+  delayed_tasks_cv_.notify_one();
   worker_cv_.notify_all();
+  lock.unlock();
+  delayed_tasks_thread_.join();
+  lock.lock();
   for (auto &worker : workers_) {
     lock.unlock();
     worker.join();
     lock.lock();
   }
-  lock.unlock();
-  delayed_tasks_thread_.join();
-  lock.lock();
 }
 
 void ThreadPool::schedule(const Task &f,
                           const std::chrono::system_clock::time_point &when) {
   std::unique_lock<std::mutex> lock(mutex_);
-  if (when <= std::chrono::system_clock::now()) {
+  if (destroyed_ || when <= std::chrono::system_clock::now()) {
     tasks_.emplace_back(f);
+    worker_cv_.notify_one();
   } else {
-    delayed_tasks_.insert({when, f});
+    bool earliest =
+        delayed_tasks_.empty() || when < delayed_tasks_.top().when_;
+    delayed_tasks_.push({when, delayed_task_sequence_++, f});
+    if (earliest) delayed_tasks_cv_.notify_one();
   }
-  worker_cv_.notify_all();
 }
 
 void ThreadPool::handleDelayedTasks() {
   util::set_thread_name("cs-threadpool");
-  util::attach_thread();
-  while (true) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (destroyed_ && delayed_tasks_.empty()) {
-      break;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!destroyed_) {
+    if (delayed_tasks_.empty()) {
+      delayed_tasks_cv_.wait(lock);
+      continue;
     }
-    while (delayed_tasks_.empty() && !destroyed_) {
-      worker_cv_.wait_for(lock, std::chrono::milliseconds(100));
+    auto now = std::chrono::system_clock::now();
+    auto when = delayed_tasks_.top().when_;
+    if (when > now) {
+      delayed_tasks_cv_.wait_until(lock, when);
+      continue;
     }
-    if (!delayed_tasks_.empty()) {
-      if (delayed_tasks_.begin()->first <= std::chrono::system_clock::now() ||
-          destroyed_) {
-        auto task = *delayed_tasks_.begin();
-        delayed_tasks_.erase(delayed_tasks_.begin());
-        lock.unlock();
-        task.second();
-        lock.lock();
-      }
+    while (!delayed_tasks_.empty() && delayed_tasks_.top().when_ <= now) {
+      tasks_.emplace_back(delayed_tasks_.top().task_);
+      delayed_tasks_.pop();
+      worker_cv_.notify_one();
     }
   }
-  util::detach_thread();
 }
 
-IThreadPool::Pointer IThreadPool::create(uint32_t threads) {
+IThreadPool::Pointer IThreadPool::create(uint32_t threads, Type type) {
+  if (type == Type::WorkStealing)
+    return util::make_unique<WorkStealingThreadPool>(threads);
   return util::make_unique<ThreadPool>(threads);
 }
 
@@ -27,8 +27,8 @@
 #include <list>
 #include <mutex>
 #include <queue>
-#include <set>
 #include <thread>
+#include <vector>
 #include "IThreadPool.h"
 
 namespace cloudstorage {
@@ -41,14 +41,27 @@ class ThreadPool : public IThreadPool {
                 const std::chrono::system_clock::time_point& when) override;
 
  private:
+  struct DelayedTask {
+    std::chrono::system_clock::time_point when_;
+    uint64_t sequence_;
+    Task task_;
+
+    bool operator>(const DelayedTask& d) const {
+      return when_ > d.when_ || (when_ == d.when_ && sequence_ > d.sequence_);
+    }
+  };
+
   void handleDelayedTasks();
 
   std::mutex mutex_;
   std::condition_variable worker_cv_;
+  std::condition_variable delayed_tasks_cv_;
   std::list<Task> tasks_;
   std::list<std::thread> workers_;
-  std::set<std::pair<std::chrono::system_clock::time_point, Task>>
+  std::priority_queue<DelayedTask, std::vector<DelayedTask>,
+                      std::greater<DelayedTask>>
       delayed_tasks_;
+  uint64_t delayed_task_sequence_;
   bool destroyed_;
   std::thread delayed_tasks_thread_;
 };
@@ -25,6 +25,7 @@
 
 #include "IItem.h"
 #include "IRequest.h"
+#include "MemoryStream.h"
 
 #include <algorithm>
 #include <cctype>
@@ -480,7 +481,9 @@ std::string json::to_string(const Json::Value& json) {
   return Json::writeString(stream, json);
 }
 
-Json::Value json::from_string(const std::string& str) {
+namespace {
+
+Json::Value parse_json(std::string_view str) {
   Json::CharReaderBuilder factory;
   std::unique_ptr<Json::CharReader> reader(factory.newCharReader());
   Json::Value json;
@@ -490,14 +493,19 @@ Json::Value json::from_string(const std::string& str) {
   return json;
 }
 
+}  // namespace
+
+Json::Value json::from_string(const std::string& str) {
+  return parse_json(str);
+}
+
 Json::Value json::from_stream(std::istream&& stream) {
   return from_stream(static_cast<std::istream&>(stream));
 }
 
 Json::Value json::from_stream(std::istream& stream) {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  return from_string(sstream.str());
+  std::string storage;
+  return parse_json(view(stream, storage));
 }
 
 void set_thread_name(const std::string& name) {
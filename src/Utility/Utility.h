@@ -250,6 +250,7 @@ constexpr auto RESOLVER_NOT_SET = "resolver not set";
 constexpr auto COULD_NOT_START_HTTP_SERVER = "couldn't start http server";
 constexpr auto INVALID_RADIX_BASE = "invalid radix base";
 constexpr auto UNIMPLEMENTED = "unimplemented";
+constexpr auto FILE_TOO_BIG = "file too big";
 
 }  // namespace Error
 
@@ -326,6 +327,7 @@ class LRUCache {
     std::unique_lock<std::mutex> lock(mutex_);
     auto data_it = data_.find(key);
     if (data_it != data_.end()) {
+      data_it->second.first = value;
       mark(key, time_);
       time_++;
       return;
@@ -340,6 +342,27 @@ class LRUCache {
     }
   }
 
+  void erase(const Key& key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto data_it = data_.find(key);
+    if (data_it == data_.end()) return;
+    access_time_.erase(data_it->second.second);
+    data_.erase(data_it);
+  }
+
+  template <class Predicate>
+  void erase_if(Predicate predicate) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = data_.begin(); it != data_.end();) {
+      if (predicate(it->first, *it->second.first)) {
+        access_time_.erase(it->second.second);
+        it = data_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
  private:
   void mark(const Key& key, uint32_t time) {
     auto data_it = data_.find(key);
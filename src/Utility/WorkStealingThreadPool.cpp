@@ -0,0 +1,162 @@
+/*****************************************************************************
+ * WorkStealingThreadPool.cpp
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#include "WorkStealingThreadPool.h"
+
+#include <algorithm>
+
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+
+namespace {
+thread_local const WorkStealingThreadPool* current_pool = nullptr;
+thread_local uint32_t current_worker = 0;
+}  // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(uint32_t thread_count)
+    : next_worker_(),
+      pending_(),
+      idle_(),
+      destroyed_(false),
+      delayed_task_sequence_() {
+  thread_count = std::max<uint32_t>(thread_count, 1);
+  for (uint32_t i = 0; i < thread_count; ++i)
+    workers_.emplace_back(util::make_unique<Worker>());
+  for (uint32_t i = 0; i < thread_count; ++i)
+    workers_[i]->thread_ = std::thread(&WorkStealingThreadPool::run, this, i);
+  delayed_tasks_thread_ =
+      std::thread(&WorkStealingThreadPool::handleDelayedTasks, this);
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(delayed_tasks_mutex_);
+    destroyed_ = true;
+    // Delayed tasks which didn't fire yet are run right away by the workers.
+    while (!delayed_tasks_.empty()) {
+      push(Task(delayed_tasks_.top().task_));
+      delayed_tasks_.pop();
+    }
+    delayed_tasks_cv_.notify_one();
+  }
+  delayed_tasks_thread_.join();
+  {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.notify_all();
+  }
+  for (auto& worker : workers_) worker->thread_.join();
+}
+
+void WorkStealingThreadPool::schedule(
+    const Task& f, const std::chrono::system_clock::time_point& when) {
+  if (when <= std::chrono::system_clock::now()) return push(Task(f));
+  std::unique_lock<std::mutex> lock(delayed_tasks_mutex_);
+  if (destroyed_) return push(Task(f));
+  bool earliest = delayed_tasks_.empty() || when < delayed_tasks_.top().when_;
+  delayed_tasks_.push({when, delayed_task_sequence_++, f});
+  if (earliest) delayed_tasks_cv_.notify_one();
+}
+
+void WorkStealingThreadPool::run(uint32_t index) {
+  util::set_thread_name("cs-threadpool");
+  util::attach_thread();
+  current_pool = this;
+  current_worker = index;
+  while (true) {
+    Task task;
+    if (pop(index, task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_++;
+    while (pending_ == 0 && !destroyed_) idle_cv_.wait(lock);
+    idle_--;
+    if (pending_ == 0 && destroyed_) break;
+  }
+  util::detach_thread();
+}
+
+bool WorkStealingThreadPool::pop(uint32_t index, Task& task) {
+  {
+    auto& worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex_);
+    if (!worker.tasks_.empty()) {
+      task = std::move(worker.tasks_.front());
+      worker.tasks_.pop_front();
+      pending_--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < workers_.size(); i++) {
+    auto& victim = *workers_[(index + i) % workers_.size()];
+    std::unique_lock<std::mutex> lock(victim.mutex_);
+    if (!victim.tasks_.empty()) {
+      task = std::move(victim.tasks_.back());
+      victim.tasks_.pop_back();
+      pending_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::push(Task&& task) {
+  auto index = current_pool == this ? current_worker
+                                    : next_worker_++ % workers_.size();
+  {
+    auto& worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex_);
+    worker.tasks_.emplace_back(std::move(task));
+  }
+  // Pairs with the idle_ increment and pending_ check in run: either the
+  // worker sees the task or we see the worker waiting and wake it.
+  pending_++;
+  if (idle_ > 0) {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.notify_one();
+  }
+}
+
+void WorkStealingThreadPool::handleDelayedTasks() {
+  util::set_thread_name("cs-threadpool");
+  std::unique_lock<std::mutex> lock(delayed_tasks_mutex_);
+  while (!destroyed_) {
+    if (delayed_tasks_.empty()) {
+      delayed_tasks_cv_.wait(lock);
+      continue;
+    }
+    auto now = std::chrono::system_clock::now();
+    auto when = delayed_tasks_.top().when_;
+    if (when > now) {
+      delayed_tasks_cv_.wait_until(lock, when);
+      continue;
+    }
+    while (!delayed_tasks_.empty() && delayed_tasks_.top().when_ <= now) {
+      push(Task(delayed_tasks_.top().task_));
+      delayed_tasks_.pop();
+    }
+  }
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,89 @@
+/*****************************************************************************
+ * WorkStealingThreadPool.h
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef WORKSTEALINGTHREADPOOL_H
+#define WORKSTEALINGTHREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "IThreadPool.h"
+
+namespace cloudstorage {
+
+// Every worker has its own queue. Tasks scheduled from a worker go to its
+// queue, other tasks are spread over the queues round robin. Idle workers
+// take tasks from the back of other workers' queues, and a single idle
+// worker is woken per scheduled task.
+class WorkStealingThreadPool : public IThreadPool {
+ public:
+  WorkStealingThreadPool(uint32_t thread_count);
+  ~WorkStealingThreadPool() override;
+  void schedule(const Task& f,
+                const std::chrono::system_clock::time_point& when) override;
+
+ private:
+  struct Worker {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+    std::thread thread_;
+  };
+
+  struct DelayedTask {
+    std::chrono::system_clock::time_point when_;
+    uint64_t sequence_;
+    Task task_;
+
+    bool operator>(const DelayedTask& d) const {
+      return when_ > d.when_ || (when_ == d.when_ && sequence_ > d.sequence_);
+    }
+  };
+
+  void run(uint32_t index);
+  bool pop(uint32_t index, Task& task);
+  void push(Task&& task);
+  void handleDelayedTasks();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<uint32_t> next_worker_;
+  std::atomic<uint64_t> pending_;
+  std::atomic<uint32_t> idle_;
+  std::atomic<bool> destroyed_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::mutex delayed_tasks_mutex_;
+  std::condition_variable delayed_tasks_cv_;
+  std::priority_queue<DelayedTask, std::vector<DelayedTask>,
+                      std::greater<DelayedTask>>
+      delayed_tasks_;
+  uint64_t delayed_task_sequence_;
+  std::thread delayed_tasks_thread_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // WORKSTEALINGTHREADPOOL_H
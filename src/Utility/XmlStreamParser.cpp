@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * XmlStreamParser.cpp : incremental xml parser
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "XmlStreamParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+namespace util {
+
+namespace {
+
+const char* WHITESPACE = " \t\r\n";
+
+bool starts_with(const std::string& str, const char* prefix) {
+  return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool ends_with(const std::string& str, const char* suffix) {
+  auto length = strlen(suffix);
+  return str.size() >= length &&
+         str.compare(str.size() - length, length, suffix) == 0;
+}
+
+std::string local_name(const std::string& name) {
+  auto colon = name.find(':');
+  return colon == std::string::npos ? name : name.substr(colon + 1);
+}
+
+void append_utf8(std::string& result, uint32_t code) {
+  if (code < 0x80) {
+    result += static_cast<char>(code);
+  } else if (code < 0x800) {
+    result += static_cast<char>(0xC0 | (code >> 6));
+    result += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    result += static_cast<char>(0xE0 | (code >> 12));
+    result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    result += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    result += static_cast<char>(0xF0 | (code >> 18));
+    result += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    result += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+void decode(const std::string& text, std::string& result) {
+  size_t position = 0;
+  while (true) {
+    auto amp = text.find('&', position);
+    auto semicolon = amp == std::string::npos ? amp : text.find(';', amp + 1);
+    if (semicolon == std::string::npos) {
+      result.append(text, position, std::string::npos);
+      return;
+    }
+    result.append(text, position, amp - position);
+    auto entity = text.substr(amp + 1, semicolon - amp - 1);
+    if (entity == "lt")
+      result += '<';
+    else if (entity == "gt")
+      result += '>';
+    else if (entity == "amp")
+      result += '&';
+    else if (entity == "quot")
+      result += '"';
+    else if (entity == "apos")
+      result += '\'';
+    else if (entity.size() > 1 && entity[0] == '#') {
+      bool hex = entity[1] == 'x' || entity[1] == 'X';
+      auto code =
+          std::stoul(entity.substr(hex ? 2 : 1), nullptr, hex ? 16 : 10);
+      append_utf8(result, static_cast<uint32_t>(code));
+    } else {
+      result.append(text, amp, semicolon - amp + 1);
+    }
+    position = semicolon + 1;
+  }
+}
+
+}  // namespace
+
+XmlStreamParser::XmlStreamParser(const StartElement& start,
+                                 const EndElement& end)
+    : start_(start),
+      end_(end),
+      in_markup_(),
+      quote_(),
+      root_closed_() {}
+
+void XmlStreamParser::parse(std::string_view data) {
+  if (error_) return;
+  try {
+    size_t position = 0;
+    while (position < data.size()) {
+      if (!in_markup_) {
+        auto next = data.find('<', position);
+        if (next == std::string_view::npos) {
+          raw_text_.append(data.substr(position));
+          break;
+        }
+        raw_text_.append(data.substr(position, next - position));
+        decode(raw_text_, text_);
+        raw_text_.clear();
+        in_markup_ = true;
+        position = next + 1;
+      } else {
+        char c = data[position++];
+        if (c == '>' && markupEnds()) {
+          in_markup_ = false;
+          markup();
+          markup_.clear();
+          continue;
+        }
+        if (!markup_.empty() && markup_[0] != '!' && markup_[0] != '?') {
+          if (quote_ == c)
+            quote_ = 0;
+          else if (!quote_ && (c == '"' || c == '\''))
+            quote_ = c;
+        }
+        markup_ += c;
+      }
+    }
+  } catch (const std::exception&) {
+    error_ = std::current_exception();
+  }
+}
+
+void XmlStreamParser::finish() {
+  if (error_) std::rethrow_exception(error_);
+  if (in_markup_ || !path_.empty() || !root_closed_)
+    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
+}
+
+XmlStreamParser::int_type XmlStreamParser::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  char data = traits_type::to_char_type(c);
+  parse(std::string_view(&data, 1));
+  return c;
+}
+
+std::streamsize XmlStreamParser::xsputn(const char* data,
+                                        std::streamsize size) {
+  if (size <= 0) return 0;
+  parse(std::string_view(data, static_cast<size_t>(size)));
+  return size;
+}
+
+bool XmlStreamParser::markupEnds() const {
+  if (starts_with(markup_, "!--"))
+    return markup_.size() >= 5 && ends_with(markup_, "--");
+  if (starts_with(markup_, "![CDATA["))
+    return markup_.size() >= 10 && ends_with(markup_, "]]");
+  if (starts_with(markup_, "?")) return ends_with(markup_, "?");
+  if (starts_with(markup_, "!"))
+    return std::count(markup_.begin(), markup_.end(), '[') ==
+           std::count(markup_.begin(), markup_.end(), ']');
+  return quote_ == 0;
+}
+
+void XmlStreamParser::markup() {
+  if (starts_with(markup_, "![CDATA[")) {
+    text_.append(markup_, 8, markup_.size() - 10);
+  } else if (starts_with(markup_, "/")) {
+    auto end = markup_.find_first_of(WHITESPACE);
+    endElement(markup_.substr(1, end == std::string::npos ? end : end - 1));
+  } else if (!starts_with(markup_, "!") && !starts_with(markup_, "?")) {
+    bool empty = ends_with(markup_, "/");
+    auto end = markup_.find_first_of(std::string(WHITESPACE) + "/");
+    auto name = markup_.substr(0, end);
+    startElement(name);
+    if (empty) endElement(name);
+  }
+}
+
+void XmlStreamParser::startElement(const std::string& name) {
+  if (name.empty() || root_closed_)
+    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
+  path_.push_back(local_name(name));
+  text_.clear();
+  if (start_) start_(path_);
+}
+
+void XmlStreamParser::endElement(const std::string& name) {
+  if (path_.empty() || path_.back() != local_name(name))
+    throw std::logic_error(util::Error::FAILED_TO_PARSE_XML);
+  if (end_) end_(path_, text_);
+  text_.clear();
+  path_.pop_back();
+  if (path_.empty()) root_closed_ = true;
+}
+
+}  // namespace util
+}  // namespace cloudstorage
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * XmlStreamParser.h : incremental xml parser
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef XMLSTREAMPARSER_H
+#define XMLSTREAMPARSER_H
+
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cloudstorage {
+namespace util {
+
+// Parses xml written to it piece by piece, so that responses can be handled
+// while they're downloaded, without keeping the whole document in memory.
+// Elements are reported by their path from the root, with namespace prefixes
+// dropped; the text of an element is the text it contains after its last
+// child. Attributes, comments and processing instructions are skipped.
+class XmlStreamParser : public std::streambuf {
+ public:
+  using Path = std::vector<std::string>;
+  using StartElement = std::function<void(const Path&)>;
+  using EndElement = std::function<void(const Path&, const std::string& text)>;
+
+  XmlStreamParser(const StartElement&, const EndElement&);
+
+  void parse(std::string_view);
+
+  // Throws std::logic_error if the document is malformed or incomplete, or
+  // rethrows the first exception thrown by a callback.
+  void finish();
+
+ protected:
+  int_type overflow(int_type) override;
+  std::streamsize xsputn(const char*, std::streamsize) override;
+
+ private:
+  bool markupEnds() const;
+  void markup();
+  void startElement(const std::string& name);
+  void endElement(const std::string& name);
+
+  StartElement start_;
+  EndElement end_;
+  Path path_;
+  bool in_markup_;
+  char quote_;
+  bool root_closed_;
+  std::string markup_;
+  std::string raw_text_;
+  std::string text_;
+  std::exception_ptr error_;
+};
+
+}  // namespace util
+}  // namespace cloudstorage
+
+#endif  // XMLSTREAMPARSER_H
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 
+#include "Utility/CloudAccess.h"
 #include "Utility/CloudFactoryMock.h"
 #include "Utility/Item.h"
 #include "Utility/Utility.h"
@@ -13,6 +14,8 @@ using testing::ElementsAre;
 using testing::Field;
 using testing::Invoke;
 using testing::InvokeArgument;
+using testing::Key;
+using testing::Not;
 using testing::Pointee;
 using testing::Property;
 using testing::Return;
@@ -173,6 +176,86 @@ TEST(AmazonS3Test, DeletesItem) {
   ExpectImmediatePromise(provider->deleteItem(std::make_unique<Item>("id")));
 }
 
+TEST(AmazonS3Test, DeletesDirectory) {
+  auto mock = CloudFactoryMock::create();
+  auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
+
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("GET")
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("prefix", "dir/")),
+                Not(Contains(Key("delimiter"))),
+                Not(Contains(Key("continuation-token"))))))
+      .WillRespondWith(R"(
+        <ListBucketResult>
+          <Name>bucket</Name>
+          <Contents><Key>dir/</Key></Contents>
+          <Contents><Key>dir/a&amp;b</Key></Contents>
+          <IsTruncated>true</IsTruncated>
+          <NextContinuationToken>token</NextContinuationToken>
+        </ListBucketResult>
+      )")
+      .AndThen()
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("continuation-token", "token"))))
+      .WillRespondWith(R"(
+        <ListBucketResult>
+          <Name>bucket</Name>
+          <Contents><Key>dir/sub/c</Key></Contents>
+          <IsTruncated>false</IsTruncated>
+        </ListBucketResult>
+      )");
+
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("POST")
+      .WithRequestMatching(Property(&IHttpRequest::parameters,
+                                    Contains(std::make_pair("delete", ""))))
+      .WithBody("<Delete><Quiet>true</Quiet>"
+                "<Object><Key>dir/</Key></Object>"
+                "<Object><Key>dir/a&amp;b</Key></Object>"
+                "<Object><Key>dir/sub/c</Key></Object>"
+                "</Delete>")
+      .WillRespondWith("<DeleteResult></DeleteResult>");
+
+  ExpectImmediatePromise(provider->deleteItem(std::make_unique<Item>(
+      "dir", "dir/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory)));
+}
+
+TEST(AmazonS3Test, ReportsKeysWhichFailedToBeDeleted) {
+  auto mock = CloudFactoryMock::create();
+  auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
+
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("GET")
+      .WillRespondWith(R"(
+        <ListBucketResult>
+          <Name>bucket</Name>
+          <Contents><Key>dir/a</Key></Contents>
+          <IsTruncated>false</IsTruncated>
+        </ListBucketResult>
+      )");
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("POST")
+      .WillRespondWith(R"(
+        <DeleteResult>
+          <Error>
+            <Key>dir/a</Key>
+            <Code>AccessDenied</Code>
+            <Message>Access Denied</Message>
+          </Error>
+        </DeleteResult>
+      )");
+
+  ExpectFailedPromise(
+      provider->deleteItem(std::make_unique<Item>(
+          "dir", "dir/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+          IItem::FileType::Directory)),
+      Field(&Error::description_, "Access Denied"));
+}
+
 TEST(AmazonS3Test, CreatesDirectory) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
@@ -221,6 +304,54 @@ TEST(AmazonS3Test, MovesItem) {
           Property(&IItem::id, "root/some_directory/destination/source_id"))));
 }
 
+TEST(AmazonS3Test, MovesDirectory) {
+  auto mock = CloudFactoryMock::create();
+  auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
+
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("GET")
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("prefix", "root/source/"))))
+      .WillRespondWith(R"(
+        <ListBucketResult>
+          <Name>bucket</Name>
+          <Contents><Key>root/source/</Key></Contents>
+          <Contents><Key>root/source/a</Key></Contents>
+          <Contents><Key>root/source/sub/b</Key></Contents>
+          <IsTruncated>false</IsTruncated>
+        </ListBucketResult>
+      )");
+  for (auto key : {"source/", "source/a", "source/sub/b"})
+    ExpectHttp(mock.http(), "endpoint/bucket/destination/" + std::string(key))
+        .WithMethod("PUT")
+        .WithRequestMatching(Property(
+            &IHttpRequest::headerParameters,
+            Contains(std::make_pair("x-amz-copy-source",
+                                    "bucket/root/" + std::string(key)))))
+        .WillRespondWithCode(200);
+  ExpectHttp(mock.http(), "endpoint/bucket/")
+      .WithMethod("POST")
+      .WithBody("<Delete><Quiet>true</Quiet>"
+                "<Object><Key>root/source/</Key></Object>"
+                "<Object><Key>root/source/a</Key></Object>"
+                "<Object><Key>root/source/sub/b</Key></Object>"
+                "</Delete>")
+      .WillRespondWith("<DeleteResult></DeleteResult>");
+
+  auto source = std::make_shared<Item>(
+      "source", "root/source/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  auto destination = std::make_shared<Item>(
+      "destination", "destination/", IItem::UnknownSize,
+      IItem::UnknownTimeStamp, IItem::FileType::Directory);
+
+  ExpectImmediatePromise(
+      provider->moveItem(source, destination),
+      Pointee(AllOf(Property(&IItem::filename, "source"),
+                    Property(&IItem::id, "destination/source/"))));
+}
+
 TEST(AmazonS3Test, RenamesItem) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
@@ -266,6 +397,359 @@ TEST(AmazonS3Test, UploadsItem) {
                          Pointee(Property(&IItem::filename, "filename")));
 }
 
+TEST(AmazonS3Test, UploadsItemInParts) {
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["upload_chunk_size"] = "5242880";
+  data.hints_["upload_concurrency"] = "2";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  std::string chunk(5242880, 'x');
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WithRequestMatching(Property(&IHttpRequest::parameters,
+                                    Contains(std::make_pair("uploads", ""))))
+      .WillRespondWith(R"(
+        <?xml version="1.0" encoding="UTF-8"?>
+        <InitiateMultipartUploadResult>
+          <Bucket>bucket</Bucket>
+          <Key>parent_id/filename</Key>
+          <UploadId>upload_id</UploadId>
+        </InitiateMultipartUploadResult>
+      )")
+      .AndThen()
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("uploadId", "upload_id"))))
+      .WithBody(
+          "<CompleteMultipartUpload>"
+          "<Part><PartNumber>1</PartNumber><ETag>\"etag1\"</ETag></Part>"
+          "<Part><PartNumber>2</PartNumber><ETag>\"etag2\"</ETag></Part>"
+          "</CompleteMultipartUpload>")
+      .WillRespondWith(R"(
+        <?xml version="1.0" encoding="UTF-8"?>
+        <CompleteMultipartUploadResult>
+          <Key>parent_id/filename</Key>
+        </CompleteMultipartUploadResult>
+      )");
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("PUT")
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("partNumber", "1")),
+                Contains(std::make_pair("uploadId", "upload_id")))))
+      .WithBody(chunk)
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag1\""}}))
+      .AndThen()
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("partNumber", "2")),
+                Contains(std::make_pair("uploadId", "upload_id")))))
+      .WithBody("content")
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag2\""}}));
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+
+  auto stream = std::make_shared<std::stringstream>();
+  *stream << chunk << "content";
+  ExpectImmediatePromise(provider->uploadFile(parent, "filename",
+                                              provider->streamUploader(stream)),
+                         Pointee(Property(&IItem::filename, "filename")));
+  EXPECT_EQ(provider->hints().count("multipart_uploads"), 0u);
+}
+
+namespace {
+// Uploads a file of two parts, of which the second one fails with code.
+ICloudProvider::Hints FailMultipartUpload(const std::string& content,
+                                          int code) {
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["upload_chunk_size"] = "5242880";
+  data.hints_["upload_concurrency"] = "1";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WillRespondWith(
+          "<InitiateMultipartUploadResult>"
+          "<UploadId>upload_id</UploadId>"
+          "</InitiateMultipartUploadResult>");
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("PUT")
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("partNumber", "1"))))
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag1\""}}))
+      .AndThen()
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("partNumber", "2"))))
+      .WillRespondWithCode(code);
+
+  if (code / 100 == 4)
+    ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+        .WithMethod("DELETE")
+        .WithRequestMatching(
+            Property(&IHttpRequest::parameters,
+                     Contains(std::make_pair("uploadId", "upload_id"))))
+        .WillRespondWithCode(204);
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  auto stream = std::make_shared<std::stringstream>(content);
+  ExpectFailedPromise(provider->uploadFile(parent, "filename",
+                                           provider->streamUploader(stream)),
+                      Field(&Error::code_, code));
+  return provider->hints();
+}
+}  // namespace
+
+TEST(AmazonS3Test, ResumesMultipartUpload) {
+  auto content = std::string(5242880, 'x') + "content";
+  auto hints = FailMultipartUpload(content, IHttpRequest::ServiceUnavailable);
+  ASSERT_EQ(hints.count("multipart_uploads"), 1u);
+
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["multipart_uploads"] = hints["multipart_uploads"];
+  auto provider = mock.factory()->create("amazons3", data);
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("PUT")
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("partNumber", "2")),
+                Contains(std::make_pair("uploadId", "upload_id")))))
+      .WithBody("content")
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag2\""}}));
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("uploadId", "upload_id"))))
+      .WithBody(
+          "<CompleteMultipartUpload>"
+          "<Part><PartNumber>1</PartNumber><ETag>\"etag1\"</ETag></Part>"
+          "<Part><PartNumber>2</PartNumber><ETag>\"etag2\"</ETag></Part>"
+          "</CompleteMultipartUpload>")
+      .WillRespondWith("<CompleteMultipartUploadResult/>");
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+
+  auto stream = std::make_shared<std::stringstream>(content);
+  ExpectImmediatePromise(provider->uploadFile(parent, "filename",
+                                              provider->streamUploader(stream)),
+                         Pointee(Property(&IItem::filename, "filename")));
+  EXPECT_EQ(provider->hints().count("multipart_uploads"), 0u);
+}
+
+TEST(AmazonS3Test, ResendsChangedPartsOfResumedUpload) {
+  auto hints = FailMultipartUpload(std::string(5242880, 'x') + "content",
+                                   IHttpRequest::ServiceUnavailable);
+  ASSERT_EQ(hints.count("multipart_uploads"), 1u);
+
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["multipart_uploads"] = hints["multipart_uploads"];
+  data.hints_["upload_concurrency"] = "1";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  std::string chunk(5242880, 'y');
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("PUT")
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("partNumber", "1")),
+                Contains(std::make_pair("uploadId", "upload_id")))))
+      .WithBody(chunk)
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag3\""}}))
+      .AndThen()
+      .WithRequestMatching(Property(
+          &IHttpRequest::parameters,
+          AllOf(Contains(std::make_pair("partNumber", "2")),
+                Contains(std::make_pair("uploadId", "upload_id")))))
+      .WithBody("content")
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag2\""}}));
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WithBody(
+          "<CompleteMultipartUpload>"
+          "<Part><PartNumber>1</PartNumber><ETag>\"etag3\"</ETag></Part>"
+          "<Part><PartNumber>2</PartNumber><ETag>\"etag2\"</ETag></Part>"
+          "</CompleteMultipartUpload>")
+      .WillRespondWith("<CompleteMultipartUploadResult/>");
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+
+  auto stream = std::make_shared<std::stringstream>(chunk + "content");
+  ExpectImmediatePromise(provider->uploadFile(parent, "filename",
+                                              provider->streamUploader(stream)),
+                         Pointee(Property(&IItem::filename, "filename")));
+}
+
+TEST(AmazonS3Test, AbortsRejectedMultipartUpload) {
+  auto hints = FailMultipartUpload(std::string(5242880, 'x') + "content",
+                                   IHttpRequest::Bad);
+  EXPECT_EQ(hints.count("multipart_uploads"), 0u);
+}
+
+namespace {
+
+class StreamCallback : public IUploadStreamCallback {
+ public:
+  void write(const std::string& data) {
+    data_ += data;
+    if (ready_ && data_.size() >= end_) std::exchange(ready_, nullptr)(nullptr);
+  }
+
+  void finish() {
+    size_ = data_.size();
+    if (ready_) std::exchange(ready_, nullptr)(nullptr);
+  }
+
+  void waitForData(uint64_t offset, uint64_t length,
+                   std::function<void(EitherError<void>)> ready) override {
+    end_ = offset + length;
+    ready_ = std::move(ready);
+    if (size_ != IItem::UnknownSize || data_.size() >= end_)
+      std::exchange(ready_, nullptr)(nullptr);
+  }
+
+  void releaseData(uint64_t, uint64_t length) override { released_ += length; }
+
+  uint32_t putData(char* data, uint32_t maxlength, uint64_t offset) override {
+    auto size = data_.copy(data, maxlength, offset);
+    return static_cast<uint32_t>(size);
+  }
+
+  uint64_t size() override { return size_; }
+
+  void progress(uint64_t, uint64_t) override {}
+
+  void done(EitherError<IItem> e) override { result_ = e; }
+
+  std::string data_;
+  uint64_t end_ = 0;
+  uint64_t size_ = IItem::UnknownSize;
+  uint64_t released_ = 0;
+  std::function<void(EitherError<void>)> ready_;
+  EitherError<IItem> result_;
+};
+
+}  // namespace
+
+TEST(AmazonS3Test, StreamsUploadOfUnknownSize) {
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["upload_chunk_size"] = "5242880";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  std::string chunk(5242880, 'x');
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WithRequestMatching(Property(&IHttpRequest::parameters,
+                                    Contains(std::make_pair("uploads", ""))))
+      .WillRespondWith(
+          "<InitiateMultipartUploadResult>"
+          "<UploadId>upload_id</UploadId>"
+          "</InitiateMultipartUploadResult>")
+      .AndThen()
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("uploadId", "upload_id"))))
+      .WithBody(
+          "<CompleteMultipartUpload>"
+          "<Part><PartNumber>1</PartNumber><ETag>\"etag1\"</ETag></Part>"
+          "<Part><PartNumber>2</PartNumber><ETag>\"etag2\"</ETag></Part>"
+          "</CompleteMultipartUpload>")
+      .WillRespondWith("<CompleteMultipartUploadResult/>");
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("PUT")
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("partNumber", "1"))))
+      .WithBody(chunk)
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag1\""}}))
+      .AndThen()
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("partNumber", "2"))))
+      .WithBody("content")
+      .WillRespondWith(HttpResponse().WithHeaders({{"etag", "\"etag2\""}}));
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  auto callback = std::make_shared<StreamCallback>();
+  auto request = static_cast<CloudAccess*>(provider.get())
+                     ->provider()
+                     ->uploadFileStreamAsync(parent, "filename", callback);
+  ASSERT_NE(request, nullptr);
+
+  callback->write(chunk.substr(0, 1024));
+  EXPECT_EQ(callback->released_, 0u);
+  callback->write(chunk.substr(1024));
+  EXPECT_EQ(callback->released_, chunk.size());
+  EXPECT_EQ(callback->result_.right(), nullptr);
+
+  callback->write("content");
+  callback->finish();
+  EXPECT_THAT(callback->result_.right(),
+              Pointee(AllOf(Property(&IItem::filename, "filename"),
+                            Property(&IItem::size, chunk.size() + 7))));
+  EXPECT_EQ(provider->hints().count("multipart_uploads"), 0u);
+}
+
+TEST(AmazonS3Test, AbortsAbandonedStreamedUpload) {
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["upload_chunk_size"] = "5242880";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("POST")
+      .WillRespondWith(
+          "<InitiateMultipartUploadResult>"
+          "<UploadId>upload_id</UploadId>"
+          "</InitiateMultipartUploadResult>");
+  ExpectHttp(mock.http(), "endpoint/bucket/parent_id/filename")
+      .WithMethod("DELETE")
+      .WithRequestMatching(
+          Property(&IHttpRequest::parameters,
+                   Contains(std::make_pair("uploadId", "upload_id"))))
+      .WillRespondWithCode(204);
+
+  auto parent = std::make_shared<Item>(
+      "directory", "parent_id/", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  auto callback = std::make_shared<StreamCallback>();
+  auto request = static_cast<CloudAccess*>(provider.get())
+                     ->provider()
+                     ->uploadFileStreamAsync(parent, "filename", callback);
+  ASSERT_NE(request, nullptr);
+
+  callback->write("content");
+  std::exchange(callback->ready_, nullptr)(
+      Error{IHttpRequest::Aborted, util::Error::ABORTED});
+  EXPECT_THAT(callback->result_.left(),
+              Pointee(Field(&Error::code_, IHttpRequest::Aborted)));
+}
+
 TEST(AmazonS3Test, DownloadsItem) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("amazons3", GetDefaultInitData());
@@ -280,6 +764,44 @@ TEST(AmazonS3Test, DownloadsItem) {
   EXPECT_EQ(stream->str(), "content");
 }
 
+TEST(AmazonS3Test, DownloadsItemInParallel) {
+  auto mock = CloudFactoryMock::create();
+  auto data = GetDefaultInitData();
+  data.hints_["download_chunk_size"] = "4";
+  data.hints_["download_concurrency"] = "2";
+  auto provider = mock.factory()->create("amazons3", data);
+
+  ExpectHttp(mock.http(), "endpoint/bucket/id")
+      .WithRequestMatching(Property(&IHttpRequest::headerParameters,
+                                    Contains(std::make_pair(
+                                        "Range", "bytes=0-3"))))
+      .WillRespondWith(HttpResponse()
+                           .WithHeaders({{"content-range", "bytes 0-3/10"}})
+                           .WithContent("0123"))
+      .AndThen()
+      .WithRequestMatching(Property(&IHttpRequest::headerParameters,
+                                    Contains(std::make_pair(
+                                        "Range", "bytes=4-7"))))
+      .WillRespondWith(HttpResponse()
+                           .WithHeaders({{"content-range", "bytes 4-7/10"}})
+                           .WithContent("4567"))
+      .AndThen()
+      .WithRequestMatching(Property(&IHttpRequest::headerParameters,
+                                    Contains(std::make_pair(
+                                        "Range", "bytes=8-9"))))
+      .WillRespondWith(HttpResponse()
+                           .WithHeaders({{"content-range", "bytes 8-9/10"}})
+                           .WithContent("89"));
+
+  auto item = std::make_shared<Item>("id", "id", 10, IItem::UnknownTimeStamp,
+                                     IItem::FileType::Unknown);
+  auto stream = std::make_shared<std::stringstream>();
+  ExpectImmediatePromise(provider->downloadFile(
+      item, FullRange, provider->streamDownloader(stream)));
+
+  EXPECT_EQ(stream->str(), "0123456789");
+}
+
 TEST(AmazonS3Test, FiguresOutRegion) {
   auto mock = CloudFactoryMock::create();
   ICloudFactory::ProviderInitData data;
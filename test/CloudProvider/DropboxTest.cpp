@@ -132,6 +132,34 @@ TEST(DropboxTest, DeletesItem) {
   ExpectImmediatePromise(provider->deleteItem(item));
 }
 
+TEST(DropboxTest, InvalidatesCachedChildrenOfDeletedDirectory) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["item_data_ttl"] = "60";
+  auto provider = mock.factory()->create("dropbox", data);
+
+  ExpectHttp(mock.http(), "https://api.dropboxapi.com/2/files/get_metadata")
+      .WithMethod("POST")
+      .WithBody(IgnoringWhitespace(R"js({ "path": "/directory/file" })js"))
+      .WillRespondWith(R"js({ "path_display": "/directory/file",
+                              "name": "file", ".tag": "file" })js")
+      .AndThen()
+      .WillRespondWith(R"js({ "path_display": "/directory/file",
+                              "name": "new_file", ".tag": "file" })js");
+  ExpectHttp(mock.http(), "https://api.dropboxapi.com/2/files/delete")
+      .WithMethod("POST")
+      .WithBody(IgnoringWhitespace(R"js({ "path": "/directory" })js"))
+      .WillRespondWith("{}");
+
+  ExpectImmediatePromise(provider->getItemData("/directory/file"),
+                         Pointee(Property(&IItem::filename, "file")));
+  ExpectImmediatePromise(provider->deleteItem(std::make_shared<Item>(
+      "directory", "/directory", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory)));
+  ExpectImmediatePromise(provider->getItemData("/directory/file"),
+                         Pointee(Property(&IItem::filename, "new_file")));
+}
+
 TEST(DropboxTest, CreatesDirectory) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("dropbox", {});
@@ -244,6 +272,81 @@ TEST(DropboxTest, UploadsItem) {
                          Pointee(Property(&IItem::filename, "new_name")));
 }
 
+TEST(DropboxTest, UploadsItemConcurrently) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["upload_chunk_size"] = "4194304";
+  data.hints_["upload_concurrency"] = "2";
+  auto provider = mock.factory()->create("dropbox", data);
+
+  std::string chunk(4194304, 'x');
+
+  ExpectHttp(mock.http(),
+             "https://content.dropboxapi.com/2/files/upload_session/start")
+      .WithMethod("POST")
+      .WithHeaderParameter("Authorization", _)
+      .WithHeaderParameter("Content-Type", "application/octet-stream")
+      .WithHeaderParameter(
+          "Dropbox-API-Arg",
+          IgnoringWhitespace(R"js({ "session_type": "concurrent" })js"))
+      .WithBody("")
+      .WillRespondWith(R"js({ "session_id": "ssid" })js");
+
+  ExpectHttp(mock.http(),
+             "https://content.dropboxapi.com/2/files/upload_session/append_v2")
+      .WithMethod("POST")
+      .WithHeaderParameter("Authorization", _)
+      .WithHeaderParameter("Content-Type", "application/octet-stream")
+      .WithHeaderParameter(
+          "Dropbox-API-Arg",
+          IgnoringWhitespace(
+              R"js({
+                     "close": false,
+                     "cursor": { "offset": 0, "session_id": "ssid" }
+                   })js"))
+      .WithBody(chunk)
+      .WillRespondWith("null")
+      .AndThen()
+      .WithHeaderParameter("Authorization", _)
+      .WithHeaderParameter("Content-Type", "application/octet-stream")
+      .WithHeaderParameter(
+          "Dropbox-API-Arg",
+          IgnoringWhitespace(
+              R"js({
+                     "close": true,
+                     "cursor": { "offset": 4194304, "session_id": "ssid" }
+                   })js"))
+      .WithBody("content")
+      .WillRespondWith("null");
+
+  ExpectHttp(mock.http(),
+             "https://content.dropboxapi.com/2/files/upload_session/finish")
+      .WithMethod("POST")
+      .WithHeaderParameter("Authorization", _)
+      .WithHeaderParameter("Content-Type", "application/octet-stream")
+      .WithHeaderParameter(
+          "Dropbox-API-Arg",
+          IgnoringWhitespace(
+              R"js({
+                     "commit": {
+                       "mode": "overwrite",
+                       "path": "/some/path/new_name"
+                     },
+                     "cursor": { "offset": 4194311, "session_id": "ssid" }
+                   })js"))
+      .WillRespondWith(R"js({ "name": "new_name" })js");
+
+  auto parent = std::make_shared<Item>(
+      "directory", "/some/path", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+
+  auto stream = std::make_shared<std::stringstream>();
+  *stream << chunk << "content";
+  ExpectImmediatePromise(provider->uploadFile(parent, "new_name",
+                                              provider->streamUploader(stream)),
+                         Pointee(Property(&IItem::filename, "new_name")));
+}
+
 TEST(DropboxTest, GetsThumbnail) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("dropbox", {});
@@ -87,6 +87,30 @@ TEST(HubiCTest, DeletesItem) {
       IItem::FileType::Unknown)));
 }
 
+TEST(HubiCTest, DeletesDirectory) {
+  auto mock = CloudFactoryMock::create();
+  auto provider = mock.factory()->create("hubic", {});
+
+  ExpectHttp(mock.http(), "/default/")
+      .WithParameter("format", "json")
+      .WithParameter("marker", "")
+      .WithParameter("path", "dir")
+      .WillRespondWith(
+          R"([{"name": "dir/a"}, {"name": "dir/b"}, {"name": "dir/c"}])")
+      .AndThen()
+      .WithParameter("format", "json")
+      .WithParameter("marker", "dir%2Fc")
+      .WithParameter("path", "dir")
+      .WillRespondWith("[]");
+  for (auto name : {"/default/dir%2Fa", "/default/dir%2Fb", "/default/dir%2Fc",
+                    "/default/dir"})
+    ExpectHttp(mock.http(), name).WithMethod("DELETE").WillRespondWithCode(200);
+
+  ExpectImmediatePromise(provider->deleteItem(std::make_unique<Item>(
+      "dir", "dir", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory)));
+}
+
 TEST(HubiCTest, CreatesDirectory) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("hubic", {});
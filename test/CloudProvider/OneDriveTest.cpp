@@ -56,6 +56,124 @@ TEST(OneDriveTest, GetsItemData) {
                          std::chrono::system_clock::from_time_t(1334203572)))));
 }
 
+TEST(OneDriveTest, CachesItemData) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["item_data_ttl"] = "60";
+  auto provider = mock.factory()->create("onedrive", data);
+
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("GET")
+      .WillRespondWith(R"js({ "name": "filename", "id": "id" })js");
+
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+}
+
+TEST(OneDriveTest, DoesntCacheItemDataByDefault) {
+  auto mock = CloudFactoryMock::create();
+  auto provider = mock.factory()->create("onedrive", {});
+
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("GET")
+      .WillRespondWith(R"js({ "name": "filename", "id": "id" })js")
+      .AndThen()
+      .WillRespondWith(R"js({ "name": "new_filename", "id": "id" })js");
+
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "new_filename")));
+}
+
+TEST(OneDriveTest, HandsOutCopiesOfCachedItemData) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["item_data_ttl"] = "60";
+  auto provider = mock.factory()->create("onedrive", data);
+
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("GET")
+      .WillRespondWith(R"js({ "name": "filename", "id": "id" })js");
+
+  provider->getItemData("id").then([](IItem::Pointer item) {
+    static_cast<Item*>(item.get())->set_filename("changed");
+  });
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+}
+
+TEST(OneDriveTest, RevalidatesCachedItemData) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["item_data_ttl"] = "0";
+  auto provider = mock.factory()->create("onedrive", data);
+
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("GET")
+      .WillRespondWith(
+          HttpResponse()
+              .WithHeaders({{"etag", "etag"}})
+              .WithContent(R"js({ "name": "filename", "id": "id" })js"))
+      .AndThen()
+      .WithHeaderParameter("Authorization", _)
+      .WithHeaderParameter("If-None-Match", "etag")
+      .WillRespondWithCode(IHttpRequest::NotModified);
+
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+}
+
+TEST(OneDriveTest, InvalidatesCachedItemDataOnDelete) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["item_data_ttl"] = "60";
+  auto provider = mock.factory()->create("onedrive", data);
+
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("GET")
+      .WillRespondWith(R"js({ "name": "filename", "id": "id" })js")
+      .AndThen()
+      .WillRespondWith(R"js({ "name": "new_filename", "id": "id" })js");
+  ExpectHttp(mock.http(), "/drive/items/id")
+      .WithMethod("DELETE")
+      .WillRespondWithCode(200);
+
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "filename")));
+  ExpectImmediatePromise(provider->deleteItem(std::make_unique<Item>(
+      "filename", "id", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Unknown)));
+  ExpectImmediatePromise(provider->getItemData("id"),
+                         Pointee(Property(&IItem::filename, "new_filename")));
+}
+
+TEST(OneDriveTest, ResolvesPathFromCachedListings) {
+  auto mock = CloudFactoryMock::create();
+  ICloudFactory::ProviderInitData data;
+  data.hints_["directory_page_ttl"] = "60";
+  auto provider = mock.factory()->create("onedrive", data);
+
+  ExpectHttp(mock.http(), "/drive/items/root/children")
+      .WillRespondWith(
+          R"js({ "value": [{ "name": "directory", "id": "directory_id",
+                             "folder": {} }] })js");
+  ExpectHttp(mock.http(), "/drive/items/directory_id/children")
+      .WillRespondWith(
+          R"js({ "value": [{ "name": "file", "id": "file_id" }] })js");
+
+  ExpectImmediatePromise(provider->getItem("/directory/file"),
+                         Pointee(Property(&IItem::id, "file_id")));
+  ExpectImmediatePromise(provider->getItem("/directory/file"),
+                         Pointee(Property(&IItem::id, "file_id")));
+  ExpectImmediatePromise(provider->getItem("/directory"),
+                         Pointee(Property(&IItem::id, "directory_id")));
+}
+
 TEST(OneDriveTest, ListsDirectory) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("onedrive", {});
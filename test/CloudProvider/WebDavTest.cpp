@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 
+#include "CloudProvider/WebDav.h"
 #include "Utility/CloudFactoryMock.h"
 #include "Utility/Item.h"
 #include "Utility/Utility.h"
@@ -55,6 +56,30 @@ TEST(WebDavTest, ListsDirectory) {
                    std::chrono::system_clock::from_time_t(1468503516))))));
 }
 
+TEST(WebDavTest, ReceivesItemsBeforeListingEnds) {
+  auto provider = std::make_shared<WebDav>();
+  std::vector<std::string> received;
+  auto stream = provider->listDirectoryStream(
+      *provider->rootDirectory(),
+      [&](IItem::Pointer item) { received.push_back(item->id()); });
+
+  *stream << R"(
+    <d:multistatus xmlns:d="DAV:">
+        <d:response><d:href>/</d:href></d:response>
+        <d:response><d:href>/file</d:href></d:response>
+        <d:response><d:hr)";
+  EXPECT_THAT(received, ElementsAre("/file"));
+
+  *stream << R"(ef>/directory/</d:href></d:response>
+    </d:multistatus>)";
+  std::string next_page_token;
+  EXPECT_THAT(stream->finish(next_page_token),
+              ElementsAre(Pointee(Property(&IItem::id, "/file")),
+                          Pointee(Property(&IItem::type,
+                                           IItem::FileType::Directory))));
+  EXPECT_THAT(received, ElementsAre("/file", "/directory/"));
+}
+
 TEST(WebDavTest, GetsGeneralData) {
   auto mock = CloudFactoryMock::create();
   auto provider = mock.factory()->create("webdav", {});
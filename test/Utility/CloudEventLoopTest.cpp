@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "Utility/CloudEventLoop.h"
+
+namespace cloudstorage {
+
+TEST(CloudEventLoopTest, ProcessesEventsInOrderOfInvocation) {
+  auto factory = IThreadPoolFactory::create();
+  CloudEventLoop loop(factory.get(), nullptr);
+  std::vector<int> order;
+  for (int i = 0; i < 3; i++)
+    loop.impl()->invoke([&, i] { order.push_back(i); });
+  loop.processEvents();
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+}
+
+TEST(CloudEventLoopTest, ProcessesEventsInvokedWhileProcessing) {
+  auto factory = IThreadPoolFactory::create();
+  CloudEventLoop loop(factory.get(), nullptr);
+  bool done = false;
+  loop.impl()->invoke([&] { loop.impl()->invoke([&] { done = true; }); });
+  loop.processEvents();
+  EXPECT_TRUE(done);
+}
+
+TEST(CloudEventLoopTest, ProcessesEventsFromManyThreads) {
+  const int THREAD_COUNT = 4;
+  const int EVENT_COUNT = 10000;
+  auto factory = IThreadPoolFactory::create();
+  CloudEventLoop loop(factory.get(), nullptr);
+  std::vector<std::vector<int>> received(THREAD_COUNT);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREAD_COUNT; t++)
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < EVENT_COUNT; i++)
+        loop.impl()->invoke([&, t, i] { received[t].push_back(i); });
+    });
+  for (int i = 0; i < 100; i++) loop.processEvents();
+  for (auto& thread : threads) thread.join();
+  loop.processEvents();
+  for (const auto& r : received) {
+    ASSERT_EQ(r.size(), static_cast<size_t>(EVENT_COUNT));
+    for (int i = 0; i < EVENT_COUNT; i++) EXPECT_EQ(r[i], i);
+  }
+}
+
+TEST(CloudEventLoopTest, NotifiesOnlyWhenEventsAreAddedToEmptyQueue) {
+  struct Callback : public ICloudFactory::ICallback {
+    void onEventsAdded() override { count_++; }
+    int count_ = 0;
+  };
+  auto factory = IThreadPoolFactory::create();
+  auto callback = std::make_shared<Callback>();
+  CloudEventLoop loop(factory.get(), callback);
+  for (int i = 0; i < 5; i++) loop.impl()->invoke([] {});
+  EXPECT_EQ(callback->count_, 1);
+  loop.processEvents();
+  loop.impl()->invoke([] {});
+  EXPECT_EQ(callback->count_, 2);
+}
+
+TEST(CloudEventLoopTest, StopsProcessingWhenDeadlinePasses) {
+  struct Callback : public ICloudFactory::ICallback {
+    void onEventsAdded() override { count_++; }
+    int count_ = 0;
+  };
+  auto factory = IThreadPoolFactory::create();
+  auto callback = std::make_shared<Callback>();
+  CloudEventLoop loop(factory.get(), callback);
+  int processed = 0;
+  for (int i = 0; i < 3; i++)
+    loop.impl()->invoke([&] {
+      processed++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
+  loop.processEvents(std::chrono::steady_clock::now());
+  EXPECT_EQ(processed, 1);
+  EXPECT_EQ(callback->count_, 2);
+  loop.processEvents();
+  EXPECT_EQ(processed, 3);
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+
+#include "Utility/MemoryStream.h"
+
+namespace cloudstorage {
+
+TEST(MemoryStreamTest, ReadsWhatWasWritten) {
+  util::MemoryStream stream;
+  stream << "first " << 42;
+  std::string word;
+  int number;
+  stream >> word >> number;
+  EXPECT_EQ(word, "first");
+  EXPECT_EQ(number, 42);
+  EXPECT_EQ(stream.str(), "first 42");
+}
+
+TEST(MemoryStreamTest, GrowsContiguously) {
+  util::MemoryStream stream;
+  std::string data(3 * util::MemoryBuffer::MIN_CAPACITY + 17, 'x');
+  stream.write(data.data(), data.size());
+  stream.put('y');
+  EXPECT_EQ(stream.view(), data + "y");
+}
+
+TEST(MemoryStreamTest, ViewSkipsConsumedData) {
+  util::MemoryStream stream;
+  stream << "header body";
+  std::string header;
+  stream >> header;
+  std::string storage;
+  EXPECT_EQ(util::view(stream, storage), " body");
+  EXPECT_TRUE(storage.empty());
+}
+
+TEST(MemoryStreamTest, ReportsLength) {
+  util::MemoryStream stream;
+  stream << "content";
+  stream.seekg(0, std::ios::end);
+  EXPECT_EQ(stream.tellg(), 7);
+  stream.seekg(0, std::ios::beg);
+  std::string content;
+  stream >> content;
+  EXPECT_EQ(content, "content");
+}
+
+TEST(MemoryStreamTest, ViewCopiesOtherStreams) {
+  std::stringstream stream("content");
+  std::string storage;
+  EXPECT_EQ(util::view(stream, storage), "content");
+}
+
+}  // namespace cloudstorage
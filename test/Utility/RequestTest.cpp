@@ -1,13 +1,21 @@
 #include "gtest/gtest.h"
 
+#include <map>
+#include <thread>
+
+#include "Request/RecursiveRequest.h"
 #include "Request/Request.h"
+#include "Request/SingleFlightRequest.h"
 #include "Utility/AuthMock.h"
 #include "Utility/CloudProviderMock.h"
+#include "Utility/Item.h"
 
 namespace cloudstorage {
 
+using ::testing::_;
 using ::testing::ByMove;
 using ::testing::Eq;
+using ::testing::Field;
 using ::testing::Invoke;
 using ::testing::InvokeArgument;
 using ::testing::MockFunction;
@@ -218,4 +226,245 @@ TEST(RequestTest, CancelPropagates) {
   EXPECT_TRUE(subrequest->is_cancelled());
 }
 
+TEST(RequestTest, SingleFlightSharesRequest) {
+  using ReturnValue = EitherError<std::string>;
+
+  auto provider = CloudProviderMock::create();
+  auto group = std::make_shared<SingleFlightRequest<ReturnValue>::Group>();
+
+  std::shared_ptr<Request<ReturnValue>> shared;
+  MockFunction<std::shared_ptr<IGenericRequest>(
+      const std::function<void(ReturnValue)>&)>
+      start;
+  EXPECT_CALL(start, Call)
+      .WillOnce(
+          Invoke([&](const std::function<void(ReturnValue)>& callback) {
+            shared = std::make_shared<Request<ReturnValue>>(
+                provider, callback,
+                [](const std::shared_ptr<Request<ReturnValue>>&) {});
+            return std::shared_ptr<IGenericRequest>(shared->run());
+          }));
+
+  MockFunction<void(ReturnValue)> callback;
+  EXPECT_CALL(callback,
+              Call(Property(&ReturnValue::right, Pointee(Eq("test")))))
+      .Times(2);
+
+  auto first = std::make_shared<SingleFlightRequest<ReturnValue>>(
+                   provider, group, "key", start.AsStdFunction(),
+                   callback.AsStdFunction())
+                   ->run();
+  auto second = std::make_shared<SingleFlightRequest<ReturnValue>>(
+                    provider, group, "key", start.AsStdFunction(),
+                    callback.AsStdFunction())
+                    ->run();
+
+  shared->done(std::string("test"));
+
+  EXPECT_THAT(first->result().right(), Pointee(Eq("test")));
+  EXPECT_THAT(second->result().right(), Pointee(Eq("test")));
+}
+
+TEST(RequestTest, SingleFlightCancelsOnlyCancelledWaiter) {
+  using ReturnValue = EitherError<std::string>;
+
+  auto provider = CloudProviderMock::create();
+  auto group = std::make_shared<SingleFlightRequest<ReturnValue>::Group>();
+
+  std::shared_ptr<Request<ReturnValue>> shared;
+  auto start = [&](const std::function<void(ReturnValue)>& callback) {
+    shared = std::make_shared<Request<ReturnValue>>(
+        provider, callback,
+        [](const std::shared_ptr<Request<ReturnValue>>&) {});
+    return std::shared_ptr<IGenericRequest>(shared->run());
+  };
+
+  MockFunction<void(ReturnValue)> first_callback;
+  MockFunction<void(ReturnValue)> second_callback;
+  EXPECT_CALL(first_callback,
+              Call(Property(&ReturnValue::left,
+                            Pointee(Field(&Error::code_,
+                                          Eq(IHttpRequest::Aborted))))));
+  EXPECT_CALL(second_callback,
+              Call(Property(&ReturnValue::right, Pointee(Eq("test")))));
+
+  auto first = std::make_shared<SingleFlightRequest<ReturnValue>>(
+                   provider, group, "key", start,
+                   first_callback.AsStdFunction())
+                   ->run();
+  auto second = std::make_shared<SingleFlightRequest<ReturnValue>>(
+                    provider, group, "key", start,
+                    second_callback.AsStdFunction())
+                    ->run();
+
+  first->cancel();
+  EXPECT_FALSE(shared->is_cancelled());
+
+  shared->done(std::string("test"));
+
+  EXPECT_THAT(second->result().right(), Pointee(Eq("test")));
+}
+
+TEST(RequestTest, SingleFlightCancelsSharedRequestWithLastWaiter) {
+  using ReturnValue = EitherError<std::string>;
+
+  class CancellableRequest : public Request<ReturnValue> {
+   public:
+    using Request::Request;
+
+    void cancel() override {
+      if (!is_cancelled())
+        done(Error{IHttpRequest::Aborted, util::Error::ABORTED});
+      Request::cancel();
+    }
+  };
+
+  auto provider = CloudProviderMock::create();
+  auto group = std::make_shared<SingleFlightRequest<ReturnValue>::Group>();
+
+  std::shared_ptr<Request<ReturnValue>> shared;
+  auto start = [&](const std::function<void(ReturnValue)>& callback) {
+    shared = std::make_shared<CancellableRequest>(
+        provider, callback,
+        [](const std::shared_ptr<Request<ReturnValue>>&) {});
+    return std::shared_ptr<IGenericRequest>(shared->run());
+  };
+
+  MockFunction<void(ReturnValue)> callback;
+  EXPECT_CALL(callback, Call(Property(&ReturnValue::left, Pointee(Field(
+                                           &Error::code_,
+                                           Eq(IHttpRequest::Aborted))))))
+      .Times(2);
+
+  auto first =
+      std::make_shared<SingleFlightRequest<ReturnValue>>(
+          provider, group, "key", start, callback.AsStdFunction())
+          ->run();
+  auto second =
+      std::make_shared<SingleFlightRequest<ReturnValue>>(
+          provider, group, "key", start, callback.AsStdFunction())
+          ->run();
+
+  first->cancel();
+  EXPECT_FALSE(shared->is_cancelled());
+  second->cancel();
+  EXPECT_TRUE(shared->is_cancelled());
+}
+
+TEST(RequestTest, RecursiveRequestStopsAtFirstError) {
+  using ReturnValue = EitherError<void>;
+  using Visitor = RecursiveRequest<ReturnValue>::Visitor;
+
+  auto provider = CloudProviderMock::create();
+  auto directory = std::make_shared<Item>(
+      "dir", "dir", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  auto list = std::make_shared<IItem::List>();
+  for (auto name : {"a", "b", "c", "d"})
+    list->push_back(std::make_shared<Item>(name, name, 0,
+                                           IItem::UnknownTimeStamp,
+                                           IItem::FileType::Unknown));
+
+  EXPECT_CALL(*provider, listDirectorySimpleAsync(Eq(directory), _))
+      .WillOnce(Invoke([=, p = provider.get()](IItem::Pointer,
+                                               ListDirectoryCallback callback) {
+        return std::make_shared<Request<EitherError<IItem::List>>>(
+                   p->shared_from_this(), callback,
+                   [=](std::shared_ptr<Request<EitherError<IItem::List>>> r) {
+                     r->done(*list);
+                   })
+            ->run();
+      }));
+
+  MockFunction<void(std::string)> visited;
+  EXPECT_CALL(visited, Call("d"));
+  EXPECT_CALL(visited, Call("c"));
+  Visitor visitor = [&](std::shared_ptr<Request<ReturnValue>>,
+                        IItem::Pointer item,
+                        RecursiveRequest<ReturnValue>::CompleteCallback
+                            callback) {
+    visited.Call(item->id());
+    if (item->id() == "c")
+      callback(Error{IHttpRequest::InternalServerError, ""});
+    else
+      callback(nullptr);
+  };
+
+  MockFunction<void(ReturnValue)> callback;
+  EXPECT_CALL(callback,
+              Call(Property(&ReturnValue::left,
+                            Pointee(Field(&Error::code_,
+                                          IHttpRequest::InternalServerError)))));
+
+  auto request = std::make_shared<RecursiveRequest<ReturnValue>>(
+                     provider, directory, callback.AsStdFunction(), visitor)
+                     ->run();
+  EXPECT_THAT(request->result().left(),
+              Pointee(Field(&Error::code_, IHttpRequest::InternalServerError)));
+}
+
+TEST(RequestTest, RecursiveRequestSharesConcurrencyAndCancels) {
+  using ReturnValue = EitherError<void>;
+  using Visitor = RecursiveRequest<ReturnValue>::Visitor;
+
+  auto provider = CloudProviderMock::create();
+  auto directory = std::make_shared<Item>(
+      "dir", "dir", IItem::UnknownSize, IItem::UnknownTimeStamp,
+      IItem::FileType::Directory);
+  std::map<std::string, IItem::List> listing;
+  for (auto name : {"x", "y"}) {
+    listing["dir"].push_back(std::make_shared<Item>(
+        name, name, IItem::UnknownSize, IItem::UnknownTimeStamp,
+        IItem::FileType::Directory));
+    for (auto file : {"a", "b", "c"})
+      listing[name].push_back(std::make_shared<Item>(
+          file, std::string(name) + file, 0, IItem::UnknownTimeStamp,
+          IItem::FileType::Unknown));
+  }
+
+  EXPECT_CALL(*provider, listDirectorySimpleAsync)
+      .WillRepeatedly(Invoke([&, p = provider.get()](
+                                 IItem::Pointer item,
+                                 ListDirectoryCallback callback) {
+        auto lst = listing[item->id()];
+        return std::make_shared<Request<EitherError<IItem::List>>>(
+                   p->shared_from_this(), callback,
+                   [=](std::shared_ptr<Request<EitherError<IItem::List>>> r) {
+                     r->done(lst);
+                   })
+            ->run();
+      }));
+
+  std::mutex mutex;
+  std::vector<RecursiveRequest<ReturnValue>::CompleteCallback> running;
+  Visitor visitor = [&](std::shared_ptr<Request<ReturnValue>>, IItem::Pointer,
+                        RecursiveRequest<ReturnValue>::CompleteCallback
+                            callback) {
+    std::unique_lock<std::mutex> lock(mutex);
+    running.push_back(callback);
+  };
+
+  MockFunction<void(ReturnValue)> callback;
+  EXPECT_CALL(callback,
+              Call(Property(&ReturnValue::left,
+                            Pointee(Field(&Error::code_,
+                                          IHttpRequest::Aborted)))));
+
+  auto request = std::make_shared<RecursiveRequest<ReturnValue>>(
+      provider, directory, callback.AsStdFunction(), visitor);
+  auto wrapper = request->run();
+  // Both directories' files wait for the same recursive_concurrency slots.
+  EXPECT_EQ(running.size(), provider->recursive_concurrency());
+
+  std::thread cancel([&] { wrapper->cancel(); });
+  while (!request->is_cancelled()) std::this_thread::yield();
+  auto visited = running;
+  for (const auto& c : visited) c(nullptr);
+  cancel.join();
+
+  EXPECT_EQ(running.size(), visited.size());
+  EXPECT_THAT(wrapper->result().left(),
+              Pointee(Field(&Error::code_, IHttpRequest::Aborted)));
+}
+
 }  // namespace cloudstorage
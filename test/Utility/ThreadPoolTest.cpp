@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IThreadPool.h"
+
+namespace cloudstorage {
+
+using std::chrono::milliseconds;
+using std::chrono::system_clock;
+
+class ThreadPoolTest : public testing::TestWithParam<IThreadPool::Type> {};
+
+TEST_P(ThreadPoolTest, RunsTasksScheduledFromTasks) {
+  std::atomic<int> count(0);
+  {
+    auto pool = IThreadPool::create(4, GetParam());
+    for (int i = 0; i < 100; i++)
+      pool->schedule([&, pool = pool.get()] {
+        count++;
+        pool->schedule([&] { count++; });
+      });
+    while (count < 200) std::this_thread::yield();
+  }
+  EXPECT_EQ(count, 200);
+}
+
+TEST_P(ThreadPoolTest, RunsDelayedTasksInDeadlineOrder) {
+  auto pool = IThreadPool::create(1, GetParam());
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<int> order;
+  auto now = system_clock::now();
+  for (int i : {3, 1, 2})
+    pool->schedule(
+        [&, i] {
+          std::unique_lock<std::mutex> lock(mutex);
+          order.push_back(i);
+          cv.notify_one();
+        },
+        now + milliseconds(10 * i));
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return order.size() == 3; });
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3}));
+  EXPECT_GE(system_clock::now(), now + milliseconds(30));
+}
+
+TEST_P(ThreadPoolTest, RunsPendingDelayedTasksOnDestruction) {
+  std::atomic<bool> done(false);
+  {
+    auto pool = IThreadPool::create(1, GetParam());
+    pool->schedule([&] { done = true; },
+                   system_clock::now() + std::chrono::hours(1));
+  }
+  EXPECT_TRUE(done);
+}
+
+INSTANTIATE_TEST_SUITE_P(, ThreadPoolTest,
+                         testing::Values(IThreadPool::Type::Default,
+                                         IThreadPool::Type::WorkStealing));
+
+}  // namespace cloudstorage
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+#include "Utility/XmlStreamParser.h"
+
+namespace cloudstorage {
+
+namespace {
+
+class Recorder {
+ public:
+  Recorder()
+      : parser_(
+            [this](const util::XmlStreamParser::Path& path) {
+              events_.push_back("<" + join(path));
+            },
+            [this](const util::XmlStreamParser::Path& path,
+                   const std::string& text) {
+              events_.push_back(">" + join(path) + "=" + text);
+            }) {}
+
+  util::XmlStreamParser& parser() { return parser_; }
+  const std::vector<std::string>& events() const { return events_; }
+
+ private:
+  static std::string join(const util::XmlStreamParser::Path& path) {
+    std::string result;
+    for (const auto& name : path) result += "/" + name;
+    return result;
+  }
+
+  util::XmlStreamParser parser_;
+  std::vector<std::string> events_;
+};
+
+}  // namespace
+
+TEST(XmlStreamParserTest, ParsesInputSplitAnywhere) {
+  std::string document = R"(<?xml version="1.0" encoding="UTF-8"?>
+    <!DOCTYPE root [<!ENTITY e "x">]>
+    <d:root xmlns:d="DAV:">
+      <!-- comment with <tag> -->
+      <d:item attribute="a > b" other='"'>A &amp; B &lt;&#x41;&#66;&gt;</d:item>
+      <empty/>
+      <data><![CDATA[<raw> &amp;]]></data>
+    </d:root>)";
+  Recorder expected;
+  expected.parser().parse(document);
+  expected.parser().finish();
+  EXPECT_EQ(expected.events(),
+            std::vector<std::string>(
+                {"</root", "</root/item", ">/root/item=A & B <AB>",
+                 "</root/empty", ">/root/empty=", "</root/data",
+                 ">/root/data=<raw> &amp;", ">/root=\n    "}));
+
+  Recorder recorder;
+  std::ostream stream(&recorder.parser());
+  for (char c : document) stream.put(c);
+  recorder.parser().finish();
+  EXPECT_EQ(recorder.events(), expected.events());
+}
+
+TEST(XmlStreamParserTest, RejectsMismatchedTags) {
+  Recorder recorder;
+  recorder.parser().parse("<a><b></a></b>");
+  EXPECT_THROW(recorder.parser().finish(), std::logic_error);
+}
+
+TEST(XmlStreamParserTest, RejectsIncompleteDocument) {
+  Recorder recorder;
+  recorder.parser().parse("<a><b>text</b>");
+  EXPECT_THROW(recorder.parser().finish(), std::logic_error);
+}
+
+TEST(XmlStreamParserTest, RethrowsCallbackException) {
+  int ends = 0;
+  util::XmlStreamParser parser(nullptr,
+                               [&](const util::XmlStreamParser::Path&,
+                                   const std::string&) {
+                                 ends++;
+                                 throw std::runtime_error("callback");
+                               });
+  parser.parse("<a><b/><c/></a>");
+  EXPECT_EQ(ends, 1);
+  EXPECT_THROW(parser.finish(), std::runtime_error);
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,43 @@
+#include "benchmark/benchmark.h"
+
+#include "CloudProvider/AmazonS3.h"
+#include "ICrypto.h"
+#include "Utility/Utility.h"
+#include "benchmark/FakeHttp.h"
+
+namespace cloudstorage {
+
+namespace {
+
+// Signs a listing request, as done before every S3 list and range read.
+void BM_AmazonS3SignRequest(benchmark::State& state) {
+  auto provider = std::make_shared<AmazonS3>();
+  ICloudProvider::InitData data;
+  data.token_ = util::encode_token(R"js({
+                                          "bucket": "bucket",
+                                          "endpoint": "https://s3.amazonaws.com",
+                                          "username": "username",
+                                          "password": "password"
+                                        })js");
+  data.hints_["region"] = "eu-central-1";
+  data.callback_ = std::make_shared<FakeAuthCallback>();
+  data.crypto_engine_ = ICrypto::create();
+  data.http_engine_ = std::make_unique<FakeHttp>();
+  provider->initialize(std::move(data));
+  for (auto _ : state) {
+    auto request = provider->http()->create(
+        provider->endpoint() + "/some directory/file.mp4", "GET");
+    request->setParameter("list-type", "2");
+    request->setParameter("prefix", "some directory/");
+    request->setParameter("delimiter", "/");
+    request->setHeaderParameter("Range", "bytes=0-1048575");
+    provider->authorizeRequest(*request);
+    benchmark::DoNotOptimize(request);
+  }
+}
+
+BENCHMARK(BM_AmazonS3SignRequest);
+
+}  // namespace
+
+}  // namespace cloudstorage
@@ -0,0 +1,124 @@
+/*****************************************************************************
+ * FakeHttp.h
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef FAKE_HTTP_H
+#define FAKE_HTTP_H
+
+#include <chrono>
+#include <functional>
+
+#include "ICloudProvider.h"
+#include "IHttp.h"
+#include "IThreadPool.h"
+
+namespace cloudstorage {
+
+// Answers every request with 200 and the body and headers returned by the
+// responder, after the given latency.
+class FakeHttp : public IHttp {
+ public:
+  using Responder = std::function<std::string(
+      const IHttpRequest&, IHttpRequest::HeaderParameters& headers)>;
+
+  class Request : public IHttpRequest {
+   public:
+    Request(const FakeHttp* http, const std::string& url,
+            const std::string& method, bool follow_redirect)
+        : http_(http),
+          url_(url),
+          method_(method),
+          follow_redirect_(follow_redirect) {}
+
+    void setParameter(const std::string& parameter,
+                      const std::string& value) override {
+      parameters_[parameter] = value;
+    }
+
+    void setHeaderParameter(const std::string& parameter,
+                            const std::string& value) override {
+      headers_.insert({parameter, value});
+    }
+
+    const GetParameters& parameters() const override { return parameters_; }
+
+    const HeaderParameters& headerParameters() const override {
+      return headers_;
+    }
+
+    const std::string& url() const override { return url_; }
+
+    const std::string& method() const override { return method_; }
+
+    bool follow_redirect() const override { return follow_redirect_; }
+
+    void send(CompleteCallback on_completed, std::shared_ptr<std::istream>,
+              std::shared_ptr<std::ostream> response,
+              std::shared_ptr<std::ostream> error_stream,
+              ICallback::Pointer) const override {
+      IHttpRequest::HeaderParameters headers;
+      if (http_->responder_) *response << http_->responder_(*this, headers);
+      http_->pool_->schedule(
+          [=] {
+            on_completed(
+                Response{IHttpRequest::Ok, headers, response, error_stream});
+          },
+          std::chrono::system_clock::now() + http_->latency_);
+    }
+
+   private:
+    const FakeHttp* http_;
+    std::string url_;
+    std::string method_;
+    bool follow_redirect_;
+    GetParameters parameters_;
+    HeaderParameters headers_;
+  };
+
+  FakeHttp(IThreadPool* pool = nullptr,
+           std::chrono::milliseconds latency = std::chrono::milliseconds(),
+           Responder responder = nullptr)
+      : pool_(pool), latency_(latency), responder_(std::move(responder)) {}
+
+  IHttpRequest::Pointer create(const std::string& url,
+                               const std::string& method,
+                               bool follow_redirect) const override {
+    return std::make_shared<Request>(this, url, method, follow_redirect);
+  }
+
+ private:
+  IThreadPool* pool_;
+  std::chrono::milliseconds latency_;
+  Responder responder_;
+};
+
+class FakeAuthCallback : public ICloudProvider::IAuthCallback {
+ public:
+  Status userConsentRequired(const ICloudProvider&) override {
+    return Status::None;
+  }
+
+  void done(const ICloudProvider&, EitherError<void>) override {}
+};
+
+}  // namespace cloudstorage
+
+#endif  // FAKE_HTTP_H
@@ -0,0 +1,189 @@
+#include "benchmark/benchmark.h"
+
+#include <future>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CloudProvider/AmazonS3.h"
+#include "ICrypto.h"
+#include "IFileSystem.h"
+#include "IThreadPool.h"
+#include "Utility/Utility.h"
+#include "benchmark/FakeHttp.h"
+
+namespace cloudstorage {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr uint64_t MiB = 1024 * 1024;
+constexpr uint64_t FILE_SIZE = 32 * MiB;
+constexpr uint32_t READ_SIZE = 128 * 1024;
+constexpr milliseconds LATENCY(20);
+constexpr int DIRECTORY_COUNT = 100;
+constexpr int DIRECTORY_SIZE = 1000;
+
+// The bucket holds a single FILE_SIZE file, which is served in ranges.
+std::string bucket(const IHttpRequest& request,
+                   IHttpRequest::HeaderParameters& headers) {
+  if (request.method() != "GET") return "";
+  if (request.parameters().find("list-type") != request.parameters().end())
+    return "<ListBucketResult><Name>bucket</Name>"
+           "<Contents><Key>file</Key><Size>" +
+           std::to_string(FILE_SIZE) +
+           "</Size><LastModified>2017-09-13T13:26:56.000Z</LastModified>"
+           "</Contents><IsTruncated>false</IsTruncated></ListBucketResult>";
+  auto it = request.headerParameters().find("Range");
+  if (it == request.headerParameters().end()) return "";
+  auto range = util::parse_range(it->second);
+  headers.insert({"content-range", "bytes " + std::to_string(range.start_) +
+                                       "-" +
+                                       std::to_string(range.start_ +
+                                                      range.size_ - 1) +
+                                       "/" + std::to_string(FILE_SIZE)});
+  return std::string(range.size_, 'x');
+}
+
+// The bucket holds DIRECTORY_COUNT directories of DIRECTORY_SIZE files each.
+std::string tree(const IHttpRequest& request,
+                 IHttpRequest::HeaderParameters&) {
+  auto prefix = request.parameters().find("prefix");
+  if (prefix == request.parameters().end()) return "";
+  auto directory = util::Url::unescape(prefix->second);
+  std::string result = "<ListBucketResult><Name>bucket</Name>";
+  if (directory.empty()) {
+    for (int i = 0; i < DIRECTORY_COUNT; i++)
+      result += "<CommonPrefixes><Prefix>d" + std::to_string(i) +
+                "/</Prefix></CommonPrefixes>";
+  } else {
+    for (int i = 0; i < DIRECTORY_SIZE; i++)
+      result += "<Contents><Key>" + directory + "f" + std::to_string(i) +
+                "</Key><Size>1</Size><LastModified>2017-09-13T13:26:56.000Z"
+                "</LastModified></Contents>";
+  }
+  return result + "<IsTruncated>false</IsTruncated></ListBucketResult>";
+}
+
+std::shared_ptr<AmazonS3> create_provider(IThreadPool* pool,
+                                          FakeHttp::Responder responder) {
+  auto provider = std::make_shared<AmazonS3>();
+  ICloudProvider::InitData data;
+  data.token_ = util::encode_token(R"js({
+                                          "bucket": "bucket",
+                                          "endpoint": "endpoint",
+                                          "username": "username",
+                                          "password": "password"
+                                        })js");
+  data.hints_["region"] = "region";
+  data.callback_ = std::make_shared<FakeAuthCallback>();
+  data.crypto_engine_ = ICrypto::create();
+  data.http_engine_ =
+      std::make_unique<FakeHttp>(pool, LATENCY, std::move(responder));
+  data.thread_pool_ = IThreadPool::create(1);
+  data.thumbnailer_thread_pool = IThreadPool::create(1);
+  provider->initialize(std::move(data));
+  return provider;
+}
+
+IFileSystem::FileId lookup(IFileSystem& fs, IFileSystem::FileId parent,
+                           const std::string& name) {
+  auto result = std::make_shared<std::promise<IFileSystem::FileId>>();
+  auto done = std::make_shared<std::once_flag>();
+  fs.lookup(parent, name, [=](EitherError<IFileSystem::INode> e) {
+    std::call_once(*done, [&] {
+      result->set_value(e.right() ? e.right()->inode() : 0);
+    });
+  });
+  return result->get_future().get();
+}
+
+// Reads the file sequentially in READ_SIZE pieces, as the kernel does, with
+// the given read-ahead in MiB.
+void BM_FileSystemSequentialRead(benchmark::State& state) {
+  // Outlives the providers, which the last request may release on it.
+  auto pool = IThreadPool::create(4);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto provider = create_provider(pool.get(), bucket);
+    auto fs = IFileSystem::create({{"s3", provider}},
+                                  std::make_unique<FakeHttp>(), "", "", 0,
+                                  static_cast<uint64_t>(state.range(0)) * MiB);
+    auto file = lookup(*fs, lookup(*fs, 1, "s3"), "file");
+    state.ResumeTiming();
+    for (uint64_t offset = 0; offset < FILE_SIZE; offset += READ_SIZE) {
+      std::promise<size_t> result;
+      fs->read(file, offset, READ_SIZE, [&](EitherError<Buffer> e) {
+        result.set_value(e.right() ? e.right()->size() : 0);
+      });
+      if (result.get_future().get() != READ_SIZE) {
+        state.SkipWithError("read failed");
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * FILE_SIZE));
+}
+
+BENCHMARK(BM_FileSystemSequentialRead)
+    ->Arg(0)
+    ->Arg(8)
+    ->Arg(32)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+IFileSystem::INode::List readdir(IFileSystem& fs, IFileSystem::FileId node) {
+  std::promise<IFileSystem::INode::List> result;
+  fs.readdir(node, [&](EitherError<IFileSystem::INode::List> e) {
+    result.set_value(e.right() ? *e.right() : IFileSystem::INode::List());
+  });
+  return result.get_future().get();
+}
+
+// Looks up and stats random files of the listed tree from all threads,
+// listing a whole directory every 16th time.
+void BM_FileSystemMetadata(benchmark::State& state) {
+  static auto pool = IThreadPool::create(4);
+  static IFileSystem::Pointer fs;
+  static std::vector<IFileSystem::FileId> directory;
+  if (state.thread_index() == 0) {
+    fs = IFileSystem::create({{"s3", create_provider(pool.get(), tree)}},
+                             std::make_unique<FakeHttp>(), "", "", 0, 0);
+    auto root = lookup(*fs, 1, "s3");
+    directory.clear();
+    for (int i = 0; i < DIRECTORY_COUNT; i++) {
+      directory.push_back(lookup(*fs, root, "d" + std::to_string(i)));
+      readdir(*fs, directory.back());
+    }
+  }
+  std::minstd_rand random(static_cast<uint32_t>(state.thread_index()));
+  int64_t count = 0;
+  for (auto _ : state) {
+    auto d = directory[random() % DIRECTORY_COUNT];
+    if (count++ % 16 == 0) {
+      if (readdir(*fs, d).size() != DIRECTORY_SIZE) {
+        state.SkipWithError("readdir failed");
+        break;
+      }
+      continue;
+    }
+    auto file = lookup(*fs, d, "f" + std::to_string(random() % DIRECTORY_SIZE));
+    std::promise<bool> result;
+    fs->getattr(file, [&](EitherError<IFileSystem::INode> e) {
+      result.set_value(e.right() != nullptr);
+    });
+    if (!result.get_future().get()) {
+      state.SkipWithError("lookup failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) fs = nullptr;
+}
+
+BENCHMARK(BM_FileSystemMetadata)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace cloudstorage
@@ -0,0 +1,114 @@
+#include "benchmark/benchmark.h"
+
+#include <sstream>
+#include <string>
+
+#include "CloudProvider/AmazonS3.h"
+#include "ICrypto.h"
+#include "IThreadPool.h"
+#include "Request/RecursiveRequest.h"
+#include "Utility/Item.h"
+#include "Utility/Utility.h"
+#include "benchmark/FakeHttp.h"
+
+namespace cloudstorage {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr int DIRECTORY_COUNT = 8;
+constexpr int FILE_COUNT = 16;
+constexpr milliseconds LATENCY(2);
+
+// Listings of "tree/" return DIRECTORY_COUNT subdirectories with FILE_COUNT
+// files each.
+std::string listing(const IHttpRequest& request,
+                    IHttpRequest::HeaderParameters&) {
+  auto it = request.parameters().find("prefix");
+  if (request.method() != "GET" || it == request.parameters().end())
+    return "";
+  std::stringstream stream;
+  stream << "<ListBucketResult><Name>bucket</Name>";
+  if (it->second == "tree/") {
+    for (int i = 0; i < DIRECTORY_COUNT; i++)
+      stream << "<CommonPrefixes><Prefix>tree/" << i
+             << "/</Prefix></CommonPrefixes>";
+  } else {
+    for (int i = 0; i < FILE_COUNT; i++)
+      stream << "<Contents><Key>" << it->second << i
+             << "</Key><Size>1</Size>"
+                "<LastModified>2017-09-13T13:26:56.000Z</LastModified>"
+                "</Contents>";
+  }
+  stream << "<IsTruncated>false</IsTruncated></ListBucketResult>";
+  return stream.str();
+}
+
+std::shared_ptr<AmazonS3> create_provider(IThreadPool* pool,
+                                          int concurrency) {
+  auto provider = std::make_shared<AmazonS3>();
+  ICloudProvider::InitData data;
+  data.token_ = util::encode_token(R"js({
+                                          "bucket": "bucket",
+                                          "endpoint": "endpoint",
+                                          "username": "username",
+                                          "password": "password"
+                                        })js");
+  data.hints_["region"] = "region";
+  data.hints_["recursive_concurrency"] = std::to_string(concurrency);
+  data.hints_["directory_page_ttl"] = "0";
+  data.callback_ = std::make_shared<FakeAuthCallback>();
+  data.crypto_engine_ = ICrypto::create();
+  data.http_engine_ = std::make_unique<FakeHttp>(pool, LATENCY, listing);
+  data.thread_pool_ = IThreadPool::create(1);
+  data.thumbnailer_thread_pool = IThreadPool::create(1);
+  provider->initialize(std::move(data));
+  return provider;
+}
+
+// Deletes every file and directory of the tree, one DELETE request each, as
+// AmazonS3 used to remove a directory.
+void BM_RecursiveDelete(benchmark::State& state) {
+  using Request = RecursiveRequest<EitherError<void>>;
+  // Outlives the provider, which the last request may release on it.
+  auto pool = IThreadPool::create(4);
+  auto provider =
+      create_provider(pool.get(), static_cast<int>(state.range(0)));
+  auto tree = std::make_shared<Item>("tree", "tree/", IItem::UnknownSize,
+                                     IItem::UnknownTimeStamp,
+                                     IItem::FileType::Directory);
+  auto visitor = [](Request::Pointer r, IItem::Pointer item,
+                    Request::CompleteCallback callback) {
+    r->request(
+        [=](util::Output) {
+          return r->provider()->http()->create(
+              "endpoint/bucket/" + item->id(), "DELETE");
+        },
+        [=](EitherError<Response> e) {
+          if (e.left()) return callback(e.left());
+          callback(nullptr);
+        });
+  };
+  for (auto _ : state) {
+    auto result = std::make_shared<Request>(
+                      provider, tree, [](EitherError<void>) {}, visitor)
+                      ->run()
+                      ->result();
+    if (result.left())
+      state.SkipWithError(result.left()->description_.c_str());
+  }
+  state.SetItemsProcessed(state.iterations() * DIRECTORY_COUNT *
+                          (FILE_COUNT + 1));
+}
+
+BENCHMARK(BM_RecursiveDelete)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+
+}  // namespace cloudstorage
@@ -0,0 +1,182 @@
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "IThreadPool.h"
+
+namespace cloudstorage {
+
+namespace {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::system_clock;
+
+constexpr int TIMER_COUNT = 200;
+constexpr uint32_t THREAD_COUNT = 4;
+
+void spin(microseconds duration) {
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+// Schedules delayed tasks spread over 20 ms, each followed by state.range(0)
+// immediate 50 us tasks, and reports how late the delayed tasks started.
+void BM_DelayedTaskLateness(benchmark::State& state) {
+  auto pool = IThreadPool::create(THREAD_COUNT);
+  std::vector<double> lateness;
+  for (auto _ : state) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int remaining = TIMER_COUNT;
+    auto start = system_clock::now();
+    for (int i = 0; i < TIMER_COUNT; i++) {
+      auto deadline = start + milliseconds(1 + i % 20);
+      pool->schedule(
+          [&, deadline] {
+            auto late = std::chrono::duration_cast<microseconds>(
+                system_clock::now() - deadline);
+            std::unique_lock<std::mutex> lock(mutex);
+            lateness.push_back(static_cast<double>(late.count()));
+            if (--remaining == 0) cv.notify_one();
+          },
+          deadline);
+      for (int64_t j = 0; j < state.range(0); j++)
+        pool->schedule([] { spin(microseconds(50)); });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return remaining == 0; });
+  }
+  std::sort(lateness.begin(), lateness.end());
+  double sum = 0;
+  for (auto d : lateness) sum += d;
+  state.counters["mean_late_us"] = sum / lateness.size();
+  state.counters["p99_late_us"] = lateness[lateness.size() * 99 / 100];
+  state.counters["max_late_us"] = lateness.back();
+}
+
+BENCHMARK(BM_DelayedTaskLateness)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Waits until count tasks called done().
+class Latch {
+ public:
+  explicit Latch(int count) : count_(count) {}
+
+  void done() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (--count_ == 0) cv_.notify_one();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return count_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int count_;
+};
+
+// Like generated thumbnails: every task box-filters a 512x512 rgb frame
+// down to 64x64.
+void BM_ThumbnailWorkload(benchmark::State& state, IThreadPool::Type type) {
+  constexpr int FRAME_COUNT = 64;
+  constexpr int SIZE = 512;
+  constexpr int SCALE = 8;
+  auto pool = IThreadPool::create(static_cast<uint32_t>(state.range(0)), type);
+  std::vector<uint8_t> frame(SIZE * SIZE * 3);
+  for (size_t i = 0; i < frame.size(); i++) frame[i] = static_cast<uint8_t>(i);
+  std::atomic<uint64_t> checksum(0);
+  for (auto _ : state) {
+    Latch latch(FRAME_COUNT);
+    for (int i = 0; i < FRAME_COUNT; i++)
+      pool->schedule([&] {
+        uint64_t sum = 0;
+        for (int y = 0; y < SIZE / SCALE; y++)
+          for (int x = 0; x < SIZE / SCALE; x++)
+            for (int c = 0; c < 3; c++) {
+              uint32_t pixel = 0;
+              for (int dy = 0; dy < SCALE; dy++)
+                for (int dx = 0; dx < SCALE; dx++)
+                  pixel +=
+                      frame[((y * SCALE + dy) * SIZE + x * SCALE + dx) * 3 + c];
+              sum += pixel / (SCALE * SCALE);
+            }
+        checksum += sum;
+        latch.done();
+      });
+    latch.wait();
+  }
+  benchmark::DoNotOptimize(checksum.load());
+  state.SetItemsProcessed(state.iterations() * FRAME_COUNT);
+}
+
+// Like LocalDrive requests: every task lists a small directory and stats
+// its entries, then schedules a follow up task, as a request finishing
+// schedules its callback.
+void BM_LocalDriveWorkload(benchmark::State& state, IThreadPool::Type type) {
+  constexpr int REQUEST_COUNT = 256;
+  constexpr int FILE_COUNT = 16;
+  auto directory = std::filesystem::temp_directory_path() /
+                   "cloudstorage-benchmark-localdrive";
+  std::filesystem::create_directories(directory);
+  for (int i = 0; i < FILE_COUNT; i++)
+    std::ofstream(directory / std::to_string(i)) << i;
+  auto pool = IThreadPool::create(static_cast<uint32_t>(state.range(0)), type);
+  std::atomic<uint64_t> total_size(0);
+  for (auto _ : state) {
+    Latch latch(REQUEST_COUNT);
+    for (int i = 0; i < REQUEST_COUNT; i++)
+      pool->schedule([&] {
+        uint64_t size = 0;
+        for (const auto& entry :
+             std::filesystem::directory_iterator(directory))
+          size += entry.file_size();
+        pool->schedule([&, size] {
+          total_size += size;
+          latch.done();
+        });
+      });
+    latch.wait();
+  }
+  std::filesystem::remove_all(directory);
+  benchmark::DoNotOptimize(total_size.load());
+  state.SetItemsProcessed(state.iterations() * REQUEST_COUNT);
+}
+
+BENCHMARK_CAPTURE(BM_ThumbnailWorkload, Default, IThreadPool::Type::Default)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_ThumbnailWorkload, WorkStealing,
+                  IThreadPool::Type::WorkStealing)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_LocalDriveWorkload, Default, IThreadPool::Type::Default)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_LocalDriveWorkload, WorkStealing,
+                  IThreadPool::Type::WorkStealing)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+
+}  // namespace
+
+}  // namespace cloudstorage